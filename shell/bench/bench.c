@@ -0,0 +1,346 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include "bench.h"
+#include "intrinsics/hop.h"
+#include "intrinsics/log.h"
+#include "intrinsics/hash.h"
+#include "intrinsics/dircache.h"
+#include "input/prompt.h"
+#include "jobs/jobs.h"
+#include "arena.h"
+
+/*
+Benchmark driver for the shell. It links the shell's own objects (all but
+main.o), so most cases call into the code directly: the parser, the
+dispatcher, the job table, the history file, reveal and cat. The rest run
+shell.out as a whole. Everything happens in a scratch directory, which is
+the shell's home and the place its history file is kept.
+
+The bench replaces malloc, calloc and realloc with counting wrappers
+around glibc's own, which catch glibc's internal calls as well, so that
+bench_heap can check what the shell still allocates outside its arena.
+
+Each case runs a number of rounds and reports the median, minimum and
+maximum over them. The results are written as JSON, one case per line in a
+fixed order, so two runs can be compared with diff:
+
+    make bench                       # writes bench/results/<commit>.json
+    make bench BENCH_FLAGS="-f"      # the large sizes: 1M entries, 10GB
+    bench/bench.out -m reveal -n 10  # a subset, to stdout
+*/
+
+extern char **environ;
+
+BenchConfig bench_config = { .rounds = 5 };
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long heap_calls = 0;
+
+void *malloc(size_t size) {
+    __atomic_fetch_add(&heap_calls, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    __atomic_fetch_add(&heap_calls, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_fetch_add(&heap_calls, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+static FILE *json_out;
+static int results_written = 0;
+static int devnull_fd = -1;
+static char path_buf[8192];
+
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int bench_selected(const char *name) {
+    const char *m = bench_config.match;
+    return !m || strncmp(name, m, strlen(m)) == 0;
+}
+
+int bench_group(const char *prefix) {
+    const char *m = bench_config.match;
+    size_t len = m ? strlen(m) : 0;
+    if (strlen(prefix) < len) len = strlen(prefix);
+    return !m || strncmp(prefix, m, len) == 0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void bench_report(const char *name, const char *unit, const double *values, int rounds,
+                  unsigned long ops) {
+    if (rounds <= 0) return;
+    double sorted[rounds];
+    memcpy(sorted, values, rounds * sizeof(double));
+    qsort(sorted, rounds, sizeof(double), compare_doubles);
+    double median = rounds % 2 ? sorted[rounds / 2]
+                               : (sorted[rounds / 2 - 1] + sorted[rounds / 2]) / 2;
+
+    fprintf(json_out, "%s    {\"name\": \"%s\", \"unit\": \"%s\", \"ops\": %lu, \"rounds\": %d, "
+            "\"median\": %.1f, \"min\": %.1f, \"max\": %.1f}",
+            results_written++ ? ",\n" : "", name, unit, ops, rounds, median, sorted[0],
+            sorted[rounds - 1]);
+    fflush(json_out);
+    fprintf(stderr, "%-40s %14.1f %s\n", name, median, unit);
+}
+
+void bench_latency(const char *name, long ops, BenchFn fn, void *arg) {
+    if (!bench_selected(name)) return;
+    double values[bench_config.rounds];
+    for (int r = 0; r < bench_config.rounds; r++) {
+        double start = bench_now();
+        fn(arg, ops);
+        values[r] = (bench_now() - start) / ops;
+    }
+    bench_report(name, "ns/op", values, bench_config.rounds, ops);
+}
+
+// User plus system time, in milliseconds, of the process or its reaped children.
+static double cpu_ms(int who) {
+    struct rusage ru;
+    if (getrusage(who, &ru) < 0) return 0;
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 +
+           (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+void bench_throughput(const char *name, long long bytes, BenchFn fn, void *arg) {
+    if (!bench_selected(name)) return;
+    double values[bench_config.rounds], cpu[bench_config.rounds];
+    for (int r = 0; r < bench_config.rounds; r++) {
+        double cpu_start = cpu_ms(RUSAGE_SELF) + cpu_ms(RUSAGE_CHILDREN);
+        double start = bench_now();
+        fn(arg, 1);
+        values[r] = bytes / 1e6 / ((bench_now() - start) / 1e9);
+        cpu[r] = cpu_ms(RUSAGE_SELF) + cpu_ms(RUSAGE_CHILDREN) - cpu_start;
+    }
+    bench_report(name, "MB/s", values, bench_config.rounds, 1);
+
+    char cpu_name[256];
+    snprintf(cpu_name, sizeof(cpu_name), "%s_cpu", name);
+    bench_report(cpu_name, "cpu_ms", cpu, bench_config.rounds, 1);
+}
+
+void bench_heap(const char *name, long ops, BenchFn fn, void *arg) {
+    if (!bench_selected(name)) return;
+    fn(arg, ops);
+    double values[bench_config.rounds];
+    for (int r = 0; r < bench_config.rounds; r++) {
+        unsigned long before = __atomic_load_n(&heap_calls, __ATOMIC_RELAXED);
+        fn(arg, ops);
+        values[r] = (double)(__atomic_load_n(&heap_calls, __ATOMIC_RELAXED) - before) / ops;
+    }
+    bench_report(name, "calls/op", values, bench_config.rounds, ops);
+}
+
+int bench_run(char **argv, int in_fd, int out_fd) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (in_fd >= 0) posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    if (out_fd >= 0) posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+
+    // SIGCHLD is blocked by the job code; the child gets an empty mask.
+    posix_spawnattr_t attr;
+    sigset_t empty;
+    sigemptyset(&empty);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setsigmask(&attr, &empty);
+
+    fflush(stdout);
+    pid_t pid;
+    int err = posix_spawn(&pid, argv[0], &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "bench: %s: %s\n", argv[0], strerror(err));
+        return -1;
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return exit_status(status);
+}
+
+const char *bench_path(const char *name) {
+    snprintf(path_buf, sizeof(path_buf), "%s/%s", bench_config.workdir, name);
+    return path_buf;
+}
+
+int bench_make_files(const char *dir, const char *prefix, long n) {
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror(dir);
+        return -1;
+    }
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0) {
+        perror(dir);
+        return -1;
+    }
+    // Scrambled numbers, so the directory order is not already sorted.
+    char name[256];
+    for (long i = 0; i < n; i++) {
+        unsigned long key = (unsigned long)i * 2654435761UL % 1000000007UL;
+        snprintf(name, sizeof(name), "%s%lu_%ld", prefix, key, i);
+        int fd = openat(dir_fd, name, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd < 0 && errno != EEXIST) {
+            perror(name);
+            close(dir_fd);
+            return -1;
+        }
+        if (fd >= 0) close(fd);
+    }
+    close(dir_fd);
+    return 0;
+}
+
+int bench_make_data(const char *path, long long size) {
+    struct stat st;
+    if (stat(path, &st) == 0 && st.st_size == size) return 0;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    static char block[1 << 20];
+    for (size_t i = 0; i < sizeof(block); i++) block[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+    for (long long done = 0; done < size;) {
+        long long want = size - done < (long long)sizeof(block) ? size - done : (long long)sizeof(block);
+        ssize_t n = write(fd, block, want);
+        if (n <= 0) {
+            perror(path);
+            close(fd);
+            return -1;
+        }
+        done += n;
+    }
+    close(fd);
+    return 0;
+}
+
+void bench_stdout_to(int fd) {
+    fflush(stdout);
+    dup2(fd, STDOUT_FILENO);
+}
+
+void bench_stdout_reset(void) {
+    bench_stdout_to(devnull_fd);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    if (remove(path) < 0) perror(path);
+    return 0;
+}
+
+static void print_header(const char *label) {
+    struct utsname un;
+    if (uname(&un) < 0) strcpy(un.release, "unknown");
+    char date[64];
+    time_t t = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+
+    fprintf(json_out, "{\n  \"label\": \"%s\",\n  \"date\": \"%s\",\n  \"kernel\": \"%s\",\n"
+            "  \"cpus\": %ld,\n  \"mode\": \"%s\",\n  \"results\": [\n",
+            label, date, un.release, sysconf(_SC_NPROCESSORS_ONLN),
+            bench_config.full ? "full" : "quick");
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: bench.out [-f] [-n rounds] [-m prefix] [-s shell.out] "
+            "[-l label] [-o file]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *shell = "./shell.out";
+    const char *output = NULL;
+    const char *label = "local";
+    int opt;
+    while ((opt = getopt(argc, argv, "fn:m:s:l:o:")) != -1) {
+        switch (opt) {
+        case 'f': bench_config.full = 1; break;
+        case 'n': bench_config.rounds = atoi(optarg); break;
+        case 'm': bench_config.match = optarg; break;
+        case 's': shell = optarg; break;
+        case 'l': label = optarg; break;
+        case 'o': output = optarg; break;
+        default: usage();
+        }
+    }
+    if (optind != argc || bench_config.rounds < 1) usage();
+
+    if (!realpath(shell, bench_config.shell)) {
+        fprintf(stderr, "bench: %s not found, skipping the end-to-end cases\n", shell);
+        bench_config.shell[0] = '\0';
+    }
+
+    // The results go to the real stdout (or the file); the shell code's
+    // own output goes to /dev/null.
+    json_out = output ? fopen(output, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    devnull_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    if (!json_out || devnull_fd < 0) {
+        perror(output ? output : "bench");
+        return 1;
+    }
+    bench_stdout_reset();
+
+    const char *tmp = getenv("TMPDIR");
+    snprintf(bench_config.workdir, sizeof(bench_config.workdir), "%s/shell-bench.XXXXXX",
+             tmp && *tmp ? tmp : "/tmp");
+    if (!mkdtemp(bench_config.workdir) || chdir(bench_config.workdir) < 0) {
+        perror("bench: scratch directory");
+        return 1;
+    }
+
+    init_hop();
+    init_prompt();
+    init_log();
+    init_jobs();
+
+    print_header(label);
+    bench_shell_cases();
+    bench_history_cases();
+    bench_fs_cases();
+    bench_tty_cases();
+    fprintf(json_out, "\n  ]\n}\n");
+    fclose(json_out);
+
+    cleanup_log();
+    cleanup_hash();
+    cleanup_dircache();
+    cleanup_jobs();
+    cleanup_hop();
+    arena_destroy(&line_arena);
+
+    if (chdir("/") == 0) nftw(bench_config.workdir, remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
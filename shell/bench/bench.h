@@ -0,0 +1,72 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Settings shared by every benchmark, from the command line.
+typedef struct {
+    int full;            // -f: the large sizes (1M entries, 10GB, ...)
+    int rounds;          // -n: measured rounds per case
+    const char *match;   // -m: only cases whose name starts with this
+    char shell[4096];    // -s: shell.out, for the end-to-end cases
+    char workdir[4096];  // Scratch directory, removed at exit
+} BenchConfig;
+
+extern BenchConfig bench_config;
+
+// Picks the quick or the full size of a parameter.
+#define BENCH_SIZE(quick, large) (bench_config.full ? (large) : (quick))
+
+double bench_now(void); // Monotonic clock, in nanoseconds
+
+// Whether the case should run under -m.
+int bench_selected(const char *name);
+// Whether any case under prefix may be selected, for shared setup work.
+int bench_group(const char *prefix);
+
+// Records one case. values holds a result per round in the given unit,
+// "ns/op" for latencies (lower is better), "MB/s" for throughput, "cpu_ms"
+// for the CPU time a round used or "calls/op" for heap calls; ops is how
+// many operations each round did.
+// Prints a JSON line and a summary on stderr.
+void bench_report(const char *name, const char *unit, const double *values, int rounds,
+                  unsigned long ops);
+
+// A piece of work for the helpers below; it performs ops operations.
+typedef void (*BenchFn)(void *arg, long ops);
+
+// Times fn over the configured rounds and reports ns per operation.
+// Does nothing unless the case is selected.
+void bench_latency(const char *name, long ops, BenchFn fn, void *arg);
+// Same, for fn moving bytes bytes per call (ops is 1); reports MB/s, and as
+// <name>_cpu the user plus system time of the bench and of the children it
+// reaped during the call, in cpu_ms.
+void bench_throughput(const char *name, long long bytes, BenchFn fn, void *arg);
+// Counts the heap calls (malloc, calloc, realloc, anywhere in the process)
+// fn makes per operation, after one unmeasured round to reach the steady
+// state; reports calls/op.
+void bench_heap(const char *name, long ops, BenchFn fn, void *arg);
+
+// Runs argv as a child with the given stdin and stdout (-1 to inherit),
+// waits for it and returns its exit status, or -1 if it could not start.
+int bench_run(char **argv, int in_fd, int out_fd);
+
+// Creates n empty files in dir, named with the given prefix.
+int bench_make_files(const char *dir, const char *prefix, long n);
+// Creates a file of size bytes of printable data.
+int bench_make_data(const char *path, long long size);
+// Path inside the scratch directory.
+const char *bench_path(const char *name);
+
+// While the shell's code runs, its stdout goes to /dev/null; these point it
+// somewhere else for a while and back.
+void bench_stdout_to(int fd);
+void bench_stdout_reset(void);
+
+void bench_shell_cases(void);
+void bench_history_cases(void);
+void bench_fs_cases(void);
+void bench_tty_cases(void);
+
+#endif // BENCH_H
@@ -0,0 +1,182 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "bench.h"
+#include "intrinsics/reveal.h"
+#include "intrinsics/dircache.h"
+#include "intrinsics/cat.h"
+
+// reveal on synthetic directories and trees, and cat against /bin/cat.
+
+/* ---------------- REVEAL ---------------- */
+
+typedef struct {
+    char **argv;  // reveal's arguments, NULL-terminated
+    int cold;     // Empty the directory cache first
+    int external; // argv is a program to run instead
+} Listing;
+
+static void run_listing(void *arg, long ops) {
+    Listing *l = arg;
+    char *clear[] = { "cache", "clear", NULL };
+    int argc = 0;
+    while (l->argv[argc]) argc++;
+    for (long i = 0; i < ops; i++) {
+        if (l->cold) cache_command(2, clear);
+        if (l->external) bench_run(l->argv, -1, -1);
+        else reveal_command(argc, l->argv);
+    }
+}
+
+// A tree of fanout^depth leaf directories, with files in every directory.
+static int make_tree(const char *root, int depth, int fanout, long files) {
+    if (bench_make_files(root, "f", files) < 0) return -1;
+    if (depth == 0) return 0;
+    char path[4096];
+    for (int i = 0; i < fanout; i++) {
+        snprintf(path, sizeof(path), "%s/d%d", root, i);
+        if (make_tree(path, depth - 1, fanout, files) < 0) return -1;
+    }
+    return 0;
+}
+
+static void reveal_cases(void) {
+    long entries = BENCH_SIZE(100000, 1000000);
+    char dir[4200], name[64];
+    snprintf(dir, sizeof(dir), "%s", bench_path("flat"));
+    if (bench_group("reveal/flat") && bench_make_files(dir, "file", entries) == 0) {
+        char *plain[] = { "reveal", dir, NULL };
+        Listing l = { plain, 1, 0 };
+        snprintf(name, sizeof(name), "reveal/flat_cold_%ld", entries);
+        bench_latency(name, 1, run_listing, &l);
+        l.cold = 0;
+        snprintf(name, sizeof(name), "reveal/flat_warm_%ld", entries);
+        bench_latency(name, 1, run_listing, &l);
+
+        char *sized[] = { "reveal", "-S", dir, NULL };
+        l.argv = sized;
+        snprintf(name, sizeof(name), "reveal/flat_sort_size_%ld", entries);
+        bench_latency(name, 1, run_listing, &l);
+        char *full[] = { "reveal", "-L", dir, NULL };
+        l.argv = full;
+        snprintf(name, sizeof(name), "reveal/flat_long_%ld", entries);
+        bench_latency(name, 1, run_listing, &l);
+
+        char *ls[] = { "/bin/ls", dir, NULL };
+        Listing baseline = { ls, 0, 1 };
+        snprintf(name, sizeof(name), "reveal/flat_ls_%ld", entries);
+        bench_latency(name, 1, run_listing, &baseline);
+    }
+
+    // 4^4 + ... + 1 = 341 directories.
+    long files = BENCH_SIZE(50, 500);
+    snprintf(dir, sizeof(dir), "%s", bench_path("tree"));
+    if (bench_group("reveal/tree") && make_tree(dir, 4, 4, files) == 0) {
+        char *recursive[] = { "reveal", "-R", dir, NULL };
+        Listing l = { recursive, 0, 0 };
+        const char *saved = getenv("REVEAL_THREADS");
+        char *threads_env = saved ? strdup(saved) : NULL;
+        static const char *threads[] = { "1", "4", "16" };
+        for (int i = 0; i < 3; i++) {
+            setenv("REVEAL_THREADS", threads[i], 1);
+            snprintf(name, sizeof(name), "reveal/tree_%ld_threads_%s", 341 * files, threads[i]);
+            bench_latency(name, 1, run_listing, &l);
+        }
+        if (threads_env) setenv("REVEAL_THREADS", threads_env, 1);
+        else unsetenv("REVEAL_THREADS");
+        free(threads_env);
+
+        char *ls[] = { "/bin/ls", "-R", dir, NULL };
+        Listing baseline = { ls, 0, 1 };
+        snprintf(name, sizeof(name), "reveal/tree_%ld_ls", 341 * files);
+        bench_latency(name, 1, run_listing, &baseline);
+    }
+}
+
+/* ---------------- CAT ---------------- */
+
+typedef struct {
+    char *data;   // File to copy
+    char *target; // Regular file to write, or NULL for a pipe
+    int external; // /bin/cat instead of the builtin
+} CatRun;
+
+static void run_cat(void *arg, long ops) {
+    CatRun *c = arg;
+    int out;
+    pid_t drain = -1;
+    if (c->target) {
+        out = open(c->target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    } else {
+        // A child at the other end reads everything and throws it away.
+        // It is reaped within the round, so its CPU time is counted in
+        // the _cpu case for both cats alike.
+        int fds[2];
+        if (pipe(fds) < 0) {
+            perror("pipe");
+            return;
+        }
+        fflush(stdout);
+        drain = fork();
+        if (drain == 0) {
+            static char buf[1 << 16];
+            close(fds[1]);
+            while (read(fds[0], buf, sizeof(buf)) > 0) {}
+            _exit(0);
+        }
+        close(fds[0]);
+        out = fds[1];
+    }
+    if (out < 0) {
+        perror("bench: cat output");
+        return;
+    }
+
+    char *argv[] = { c->external ? "/bin/cat" : "cat", c->data, NULL };
+    if (c->external) {
+        bench_run(argv, -1, out);
+    } else {
+        bench_stdout_to(out);
+        cat_command(2, argv);
+        bench_stdout_reset();
+    }
+    close(out);
+    while (drain > 0 && waitpid(drain, NULL, 0) < 0 && errno == EINTR) {}
+}
+
+static void cat_cases(void) {
+    long long size = BENCH_SIZE(256LL << 20, 10LL << 30);
+    char *data = strdup(bench_path("cat.dat"));
+    char *target = strdup(bench_path("cat.out"));
+    if (!data || !target || !bench_group("cat/") || bench_make_data(data, size) < 0) {
+        free(data);
+        free(target);
+        return;
+    }
+
+    char name[64];
+    const char *sizes = bench_config.full ? "10g" : "256m";
+    CatRun runs[] = {
+        { data, target, 0 }, { data, target, 1 }, { data, NULL, 0 }, { data, NULL, 1 },
+    };
+    static const char *labels[] = { "file_builtin", "file_bin", "pipe_builtin", "pipe_bin" };
+    for (int i = 0; i < 4; i++) {
+        snprintf(name, sizeof(name), "cat/%s_%s", labels[i], sizes);
+        bench_throughput(name, size, run_cat, &runs[i]);
+        unlink(target);
+    }
+    unlink(data);
+    free(data);
+    free(target);
+}
+
+void bench_fs_cases(void) {
+    reveal_cases();
+    cat_cases();
+}
@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "bench.h"
+#include "intrinsics/log.h"
+#include "jobs/jobs.h"
+#include "arena.h"
+
+// The history file: appends, listing, "log execute", "log search" over a
+// large file and many sessions sharing one file.
+
+#define SESSIONS 32
+
+static long next_command = 0;
+
+// A plausible command line, with enough variety for the search index.
+static int make_command(char *buf, size_t size, long i) {
+    static const char *forms[] = {
+        "git commit -m 'fix %lu'", "make -j%lu", "hop /src/project%lu",
+        "grep -rn pattern%lu src", "reveal -la build%lu", "cat notes%lu.txt | wc -l",
+    };
+    unsigned long key = (unsigned long)i * 2654435761UL % 100003UL;
+    return snprintf(buf, size, forms[i % 6], key);
+}
+
+static void add_commands(void *arg, long ops) {
+    char buf[128];
+    for (long i = 0; i < ops; i++) {
+        make_command(buf, sizeof(buf), next_command++);
+        add_to_log(buf);
+        arena_reset(&line_arena);
+    }
+    check_jobs(); // Reaps the compaction children
+}
+
+static void run_log(void *arg, long ops) {
+    char **argv = arg;
+    int argc = 0;
+    while (argv[argc]) argc++;
+    for (long i = 0; i < ops; i++) {
+        log_command(argc, argv);
+        arena_reset(&line_arena);
+    }
+}
+
+static void expand_execute(void *arg, long ops) {
+    for (long i = 0; i < ops; i++) {
+        if (!process_log_execute(arg)) fprintf(stderr, "bench: log execute failed\n");
+        arena_reset(&line_arena);
+    }
+}
+
+// Reopens the history from scratch, so the next search builds its index.
+static void search_cold(void *arg, long ops) {
+    cleanup_log();
+    init_log();
+    run_log(arg, 1);
+}
+
+// Writes records history records straight in the file format.
+static int make_history(const char *path, long records) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fputs("SHLOG01\n", f);
+    char buf[128];
+    for (long i = 0; i < records; i++) {
+        uint32_t len = make_command(buf, sizeof(buf), i);
+        fwrite(&len, sizeof(len), 1, f);
+        fwrite(buf, 1, len, f);
+        fwrite(&len, sizeof(len), 1, f);
+    }
+    return fclose(f);
+}
+
+// Each session appends and then lists the history, which has to catch up
+// with what the other sessions appended in the meantime.
+static void run_session(long id, long appends) {
+    cleanup_log(); // Do not share the parent's open file
+    init_log();
+    char buf[128];
+    char *argv[] = { "log", NULL };
+    for (long i = 0; i < appends; i++) {
+        snprintf(buf, sizeof(buf), "session %ld command %ld", id, i);
+        add_to_log(buf);
+        log_command(1, argv);
+        arena_reset(&line_arena);
+    }
+    fflush(stdout);
+    _exit(0);
+}
+
+static void run_sessions(void *arg, long ops) {
+    long appends = ops / SESSIONS;
+    pid_t pids[SESSIONS];
+    for (long s = 0; s < SESSIONS; s++) {
+        fflush(stdout);
+        pids[s] = fork();
+        if (pids[s] == 0) run_session(s, appends);
+        if (pids[s] < 0) perror("fork");
+    }
+    for (int s = 0; s < SESSIONS; s++) {
+        while (pids[s] > 0 && waitpid(pids[s], NULL, 0) < 0 && errno == EINTR) {}
+    }
+    check_jobs();
+}
+
+static void use_history(const char *dir, const char *histsize) {
+    cleanup_log();
+    if (histsize) setenv("HISTSIZE", histsize, 1); else unsetenv("HISTSIZE");
+    if (chdir(dir) < 0) perror(dir);
+    init_log();
+}
+
+void bench_history_cases(void) {
+    if (!bench_group("history/")) return;
+    char *workdir = bench_config.workdir;
+    const char *saved_histsize = getenv("HISTSIZE");
+    char *histsize = saved_histsize ? strdup(saved_histsize) : NULL;
+
+    // The default retention, with compaction every 15 appends.
+    use_history(workdir, NULL);
+    bench_latency("history/insert", 20000, add_commands, NULL);
+    char *list[] = { "log", NULL };
+    bench_latency("history/list", 20000, run_log, list);
+    bench_latency("history/execute_lookup", 100000, expand_execute, "log execute 15");
+
+    use_history(workdir, "0");
+    bench_latency("history/insert_unlimited", 20000, add_commands, NULL);
+
+    // A long history in its own directory, kept whole.
+    long records = BENCH_SIZE(100000, 1000000);
+    char name[64], dir[4200], path[4300];
+    snprintf(dir, sizeof(dir), "%s/history", workdir);
+    snprintf(path, sizeof(path), "%s/.shell_log", dir);
+    if ((bench_group("history/search") || bench_group("history/execute_oldest")) &&
+        mkdir(dir, 0755) == 0 && make_history(path, records) == 0) {
+        use_history(dir, "0");
+
+        char *search[] = { "log", "search", "make", "-j5", NULL };
+        snprintf(name, sizeof(name), "history/search_cold_%ld", records);
+        bench_latency(name, 1, search_cold, search);
+        snprintf(name, sizeof(name), "history/search_%ld", records);
+        bench_latency(name, 1000, run_log, search);
+        char *common[] = { "log", "search", "git", NULL };
+        snprintf(name, sizeof(name), "history/search_common_%ld", records);
+        bench_latency(name, 100, run_log, common);
+        char *prefix[] = { "log", "search", "-p", "hop /src/project1", NULL };
+        snprintf(name, sizeof(name), "history/search_prefix_%ld", records);
+        bench_latency(name, 100, run_log, prefix);
+        char *scan[] = { "log", "search", "-j", NULL };
+        snprintf(name, sizeof(name), "history/search_short_%ld", records);
+        bench_latency(name, 10, run_log, scan);
+
+        char oldest[64];
+        snprintf(oldest, sizeof(oldest), "log execute %ld", records);
+        snprintf(name, sizeof(name), "history/execute_oldest_%ld", records);
+        bench_latency(name, 1000, expand_execute, oldest);
+    }
+
+    // Sessions sharing one file, at the default retention.
+    snprintf(dir, sizeof(dir), "%s/sessions", workdir);
+    if (bench_group("history/sessions") && mkdir(dir, 0755) == 0) {
+        use_history(dir, NULL);
+        snprintf(name, sizeof(name), "history/sessions_%d", SESSIONS);
+        bench_latency(name, SESSIONS * BENCH_SIZE(200, 2000), run_sessions, NULL);
+    }
+
+    use_history(workdir, histsize);
+    free(histsize);
+}
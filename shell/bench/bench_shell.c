@@ -0,0 +1,273 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "bench.h"
+#include "cmd_exec.h"
+#include "input/parser.h"
+#include "input/prompt.h"
+#include "jobs/jobs.h"
+#include "jobs/execution.h"
+#include "exotic/activities.h"
+#include "arena.h"
+#include "trace.h"
+
+// Prompt, parser, dispatch, pipelines, the job table, tracing and whole scripts.
+
+/* ---------------- PROMPT ---------------- */
+
+static void show_prompts(void *arg, long ops) {
+    int rebuild = *(int *)arg;
+    for (long i = 0; i < ops; i++) {
+        if (rebuild) invalidate_prompt();
+        show_prompt();
+    }
+}
+
+/* ---------------- TRACING ---------------- */
+
+static void trace_spans(void *arg, long ops) {
+    for (long i = 0; i < ops; i++) {
+        long long span = trace_begin();
+        trace_end(span, "bench", arg);
+    }
+}
+
+/* ---------------- PARSER ---------------- */
+
+static void parse_lines(void *arg, long ops) {
+    const char *line = arg;
+    for (long i = 0; i < ops; i++) {
+        if (!parse_command(line)) fprintf(stderr, "bench: parse failed\n");
+        arena_reset(&line_arena);
+    }
+}
+
+// "head a0 a1 ..." with n arguments.
+static char *long_line(const char *head, int n) {
+    size_t size = strlen(head) + n * 8 + 1;
+    char *line = malloc(size);
+    if (!line) return NULL;
+    size_t used = snprintf(line, size, "%s", head);
+    for (int i = 0; i < n; i++) used += snprintf(line + used, size - used, " a%d", i);
+    return line;
+}
+
+/* ---------------- DISPATCH ---------------- */
+
+// Parses and runs a line ops times, as the main loop does.
+static void run_lines(void *arg, long ops) {
+    const char *text = arg;
+    for (long i = 0; i < ops; i++) {
+        CommandLine *cmdline = parse_command(text);
+        handle_execution_flow(cmdline);
+        arena_reset(&line_arena);
+    }
+    check_jobs();
+}
+
+static char *pipeline_of(const char *first, const char *stage, int stages) {
+    size_t size = strlen(first) + stages * (strlen(stage) + 3) + 1;
+    char *line = malloc(size);
+    if (!line) return NULL;
+    size_t used = snprintf(line, size, "%s", first);
+    for (int i = 1; i < stages; i++) used += snprintf(line + used, size - used, " | %s", stage);
+    return line;
+}
+
+/* ---------------- JOBS ---------------- */
+
+typedef struct {
+    int njobs;
+    int first_id;
+    pid_t *pids;    // Two real children per job, the first leading its group
+} JobTable;
+
+// Starts the children the jobs are made of. They only wait to be killed.
+static int start_members(JobTable *t) {
+    t->pids = malloc(2 * t->njobs * sizeof(pid_t));
+    if (!t->pids) return -1;
+    fflush(stdout);
+    for (int i = 0; i < 2 * t->njobs; i++) {
+        pid_t leader = i % 2 ? t->pids[i - 1] : 0;
+        pid_t pid = fork();
+        if (pid == 0) {
+            setpgid(0, leader);
+            while (1) pause();
+        }
+        if (pid < 0) {
+            perror("fork");
+            if (i % 2) { // Drop the half-made job
+                kill(leader, SIGKILL);
+                waitpid(leader, NULL, 0);
+            }
+            t->njobs = i / 2;
+            return t->njobs > 0 ? 0 : -1;
+        }
+        setpgid(pid, leader ? leader : pid);
+        t->pids[i] = pid;
+    }
+    return 0;
+}
+
+static void stop_members(JobTable *t) {
+    if (!t->pids) return;
+    for (int i = 0; i < 2 * t->njobs; i++) kill(t->pids[i], SIGKILL);
+    for (int i = 0; i < 2 * t->njobs; i++) waitpid(t->pids[i], NULL, 0);
+    free(t->pids);
+    t->pids = NULL;
+}
+
+static void add_jobs(JobTable *t) {
+    const char *texts[] = { "sleep 100 &", "make -j8 &", "tail -f log &", "vim notes &" };
+    for (int i = 0; i < t->njobs; i++) {
+        add_job(t->pids[2 * i], &t->pids[2 * i], NULL, 2, texts[i % 4],
+                i % 2 ? STOPPED : RUNNING);
+    }
+    Job *last = find_most_recent_job();
+    t->first_id = last ? last->job_id - t->njobs + 1 : 1;
+}
+
+static void remove_jobs(JobTable *t) {
+    for (int i = 0; i < t->njobs; i++) remove_job_by_pgid(t->pids[2 * i]);
+}
+
+// Fills the table and empties it again; ops is the table size.
+static void job_add_remove(void *arg, long ops) {
+    JobTable *t = arg;
+    add_jobs(t);
+    remove_jobs(t);
+}
+
+static void job_find(void *arg, long ops) {
+    JobTable *t = arg;
+    for (long i = 0; i < ops; i++) {
+        if (!find_job_by_id(t->first_id + i % t->njobs)) fprintf(stderr, "bench: job lost\n");
+    }
+}
+
+static void job_check(void *arg, long ops) {
+    for (long i = 0; i < ops; i++) check_jobs();
+}
+
+static void job_activities(void *arg, long ops) {
+    char *argv[] = { "activities", NULL };
+    for (long i = 0; i < ops; i++) activities_command(1, argv);
+}
+
+/* ---------------- SCRIPTS ---------------- */
+
+// Runs a whole script once; ops is its line count, so the result is per line.
+static void run_script(void *arg, long ops) {
+    char *argv[] = { bench_config.shell, arg, NULL };
+    bench_run(argv, -1, -1);
+}
+
+static const char *write_script(const char *name, const char *line, long lines) {
+    const char *path = strdup(bench_path(name));
+    FILE *f = path ? fopen(path, "w") : NULL;
+    if (!f) {
+        perror(name);
+        return NULL;
+    }
+    for (long i = 0; i < lines; i++) fprintf(f, "%s\n", line);
+    fclose(f);
+    return path;
+}
+
+void bench_shell_cases(void) {
+    int rebuild = 0;
+    bench_latency("prompt/cached", 100000, show_prompts, &rebuild);
+    rebuild = 1;
+    bench_latency("prompt/rebuild", 100000, show_prompts, &rebuild);
+
+    // What an instrumented call site costs with tracing off and on.
+    bench_latency("trace/span_off", 10000000, trace_spans, "ls -la /tmp");
+    const char *trace_file = strdup(bench_path("trace.json"));
+    if (trace_file && bench_selected("trace/span_on") && trace_start(trace_file) == 0) {
+        bench_latency("trace/span_on", 1000000, trace_spans, "ls -la /tmp");
+        trace_stop();
+        unlink(trace_file);
+    }
+    free((char *)trace_file);
+
+    bench_latency("parse/simple", 200000, parse_lines, "ls -la /tmp");
+    bench_latency("parse/pipeline", 200000, parse_lines,
+                  "cat < in.txt | grep -v foo | sort | uniq -c > out.txt ; hop .. &");
+    char *args = long_line("echo", 10000);
+    if (args) bench_latency("parse/10k_args", 100, parse_lines, args);
+    free(args);
+
+    // What a command still allocates outside the line arena once warm. The
+    // shell's own code should make no heap calls here; what remains is
+    // glibc growing its posix_spawn file-action list, once per spawn that
+    // redirects an fd.
+    bench_heap("heap/builtin", 1000, run_lines, "hop .");
+    bench_heap("heap/external", 100, run_lines, "true");
+    bench_heap("heap/redirect", 100, run_lines, "true < /dev/null > /dev/null");
+    bench_heap("heap/pipeline", 100, run_lines, "true | true | true");
+
+    bench_latency("dispatch/builtin", 20000, run_lines, "hop .");
+    bench_latency("dispatch/external", BENCH_SIZE(200, 2000), run_lines, "true");
+    args = long_line("true", 10000);
+    if (args) bench_latency("dispatch/external_10k_args", BENCH_SIZE(50, 500), run_lines, args);
+    free(args);
+
+    // Setup cost by stage count: every stage exits at once.
+    char name[64];
+    for (int stages = 1; stages <= 16; stages *= 2) {
+        snprintf(name, sizeof(name), "pipeline/setup_%d", stages);
+        char *line = pipeline_of("true", "true", stages);
+        if (line) bench_latency(name, BENCH_SIZE(50, 500), run_lines, line);
+        free(line);
+    }
+
+    // 16 cat stages, with the builtin (forked) and with /bin/cat.
+    long long size = BENCH_SIZE(64LL, 1024LL) << 20;
+    const char *data = strdup(bench_path("pipe.dat"));
+    if (data && (bench_group("pipeline/cat16") && bench_make_data(data, size) == 0)) {
+        char first[4200];
+        snprintf(first, sizeof(first), "cat %s", data);
+        char *line = pipeline_of(first, "cat", 16);
+        if (line) bench_throughput("pipeline/cat16_builtin", size, run_lines, line);
+        free(line);
+        snprintf(first, sizeof(first), "/bin/cat %s", data);
+        line = pipeline_of(first, "/bin/cat", 16);
+        if (line) bench_throughput("pipeline/cat16_bin", size, run_lines, line);
+        free(line);
+        unlink(data);
+    }
+    free((char *)data);
+
+    // Real children, two per job, so the counts stay well under pid_max.
+    JobTable table = { BENCH_SIZE(1000, 5000), 0, NULL };
+    if (bench_group("jobs/") && start_members(&table) == 0) {
+        int njobs = table.njobs;
+        snprintf(name, sizeof(name), "jobs/add_remove_%d", njobs);
+        bench_latency(name, njobs, job_add_remove, &table);
+        add_jobs(&table);
+        snprintf(name, sizeof(name), "jobs/find_%d", njobs);
+        bench_latency(name, 1000000, job_find, &table);
+        snprintf(name, sizeof(name), "jobs/check_%d", njobs);
+        bench_latency(name, 1000000, job_check, NULL);
+        snprintf(name, sizeof(name), "jobs/activities_%d", njobs);
+        bench_latency(name, 10, job_activities, NULL);
+        remove_jobs(&table);
+    }
+    stop_members(&table);
+
+    if (bench_config.shell[0] && bench_group("script/")) {
+        long lines = BENCH_SIZE(20000, 200000);
+        const char *path = write_script("builtins.sh", "hop .", lines);
+        if (path) bench_latency("script/builtin_lines", lines, run_script, (char *)path);
+        free((char *)path);
+
+        lines = BENCH_SIZE(500, 5000);
+        path = write_script("external.sh", "true", lines);
+        if (path) bench_latency("script/external_lines", lines, run_script, (char *)path);
+        free((char *)path);
+    }
+}
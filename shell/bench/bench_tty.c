@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "bench.h"
+
+// Interactive cases: shell.out on a pseudo-terminal, driven like a user.
+
+#define JOB_SLEEP_MS 100
+
+typedef struct {
+    int master;
+    pid_t pid;
+    char buf[65536];
+    size_t len;
+} Session;
+
+static int open_session(Session *s) {
+    s->len = 0;
+    s->master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (s->master < 0 || grantpt(s->master) < 0 || unlockpt(s->master) < 0) {
+        perror("bench: pty");
+        return -1;
+    }
+    const char *name = ptsname(s->master);
+    fflush(stdout);
+    s->pid = fork();
+    if (s->pid == 0) {
+        setsid();
+        int tty = open(name, O_RDWR);
+        if (tty < 0) _exit(127);
+        dup2(tty, STDIN_FILENO);
+        dup2(tty, STDOUT_FILENO);
+        dup2(tty, STDERR_FILENO);
+        sigset_t empty;
+        sigemptyset(&empty);
+        sigprocmask(SIG_SETMASK, &empty, NULL);
+        execl(bench_config.shell, bench_config.shell, (char *)NULL);
+        _exit(127);
+    }
+    return s->pid < 0 ? -1 : 0;
+}
+
+// Reads the terminal until text shows up, and drops everything up to it.
+// Returns -1 if it does not within timeout_ms.
+static int wait_for(Session *s, const char *text, int timeout_ms) {
+    double deadline = bench_now() + timeout_ms * 1e6;
+    while (1) {
+        s->buf[s->len] = '\0';
+        char *found = strstr(s->buf, text);
+        if (found) {
+            size_t used = found - s->buf + strlen(text);
+            memmove(s->buf, s->buf + used, s->len - used);
+            s->len -= used;
+            return 0;
+        }
+        int left = (deadline - bench_now()) / 1e6;
+        struct pollfd pfd = { s->master, POLLIN, 0 };
+        if (left <= 0 || poll(&pfd, 1, left) <= 0) return -1;
+        if (s->len == sizeof(s->buf) - 1) s->len = 0; // Nothing useful in there
+        ssize_t n = read(s->master, s->buf + s->len, sizeof(s->buf) - 1 - s->len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        s->len += n;
+    }
+}
+
+static void close_session(Session *s) {
+    if (write(s->master, "\004", 1) < 0 || wait_for(s, "logout", 1000) < 0) kill(s->pid, SIGKILL);
+    while (waitpid(s->pid, NULL, 0) < 0 && errno == EINTR) {}
+    close(s->master);
+}
+
+// Time from a background job's exit to its message on the terminal, while
+// the shell sits at the prompt. The job sleeps JOB_SLEEP_MS, which is
+// taken off; what is left also includes starting sleep.
+static void job_notify(void) {
+    Session s;
+    if (open_session(&s) < 0 || wait_for(&s, "> ", 2000) < 0) {
+        fprintf(stderr, "bench: no prompt from %s\n", bench_config.shell);
+        return;
+    }
+    double values[bench_config.rounds];
+    int rounds = 0;
+    char line[64];
+    int len = snprintf(line, sizeof(line), "sleep %d.%03d &\n", JOB_SLEEP_MS / 1000,
+                       JOB_SLEEP_MS % 1000);
+    for (int r = 0; r < bench_config.rounds; r++) {
+        double start = bench_now();
+        if (write(s.master, line, len) != len || wait_for(&s, "> ", 2000) < 0) break;
+        if (wait_for(&s, "exited normally", 2000) < 0) {
+            fprintf(stderr, "bench: no notification while at the prompt\n");
+            break;
+        }
+        values[rounds++] = bench_now() - start - JOB_SLEEP_MS * 1e6;
+        if (wait_for(&s, "> ", 2000) < 0) break; // The prompt drawn again
+    }
+    bench_report("notify/job_exit", "ns/op", values, rounds, 1);
+    close_session(&s);
+}
+
+void bench_tty_cases(void) {
+    if (!bench_config.shell[0]) return;
+    if (bench_selected("notify/job_exit")) job_notify();
+}
@@ -0,0 +1,40 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// A bump allocator: allocations are carved out of large chunks and are all
+// released together by arena_reset(), which is O(1). Chunks are kept across
+// resets, so once the arena has grown to fit the largest line it makes no
+// further heap calls.
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+    unsigned long allocations; // Blocks handed out since startup
+    unsigned long bytes;       // Bytes handed out since startup
+    unsigned long heap_calls;  // malloc() calls made to add chunks
+    unsigned long resets;
+    size_t reserved;           // Bytes currently held in chunks
+} ArenaStats;
+
+typedef struct {
+    ArenaChunk *first;
+    ArenaChunk *current;
+    ArenaStats stats;
+} Arena;
+
+// Scratch memory for everything built from one input line: history
+// expansion, the command tree, job strings. main() resets it per iteration.
+extern Arena line_arena;
+
+void *arena_alloc(Arena *arena, size_t size);
+// Grows ptr (of old_size bytes) in place when it is the latest allocation,
+// otherwise copies it into a new block. The old block is not reused.
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strdup(Arena *arena, const char *s);
+char *arena_strndup(Arena *arena, const char *s, size_t n);
+void arena_reset(Arena *arena);
+void arena_destroy(Arena *arena);
+const ArenaStats *arena_stats(const Arena *arena);
+
+#endif // ARENA_H
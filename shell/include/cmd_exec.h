@@ -1,7 +1,22 @@
 #ifndef CMD_EXEC_H
 #define CMD_EXEC_H
 
+#include <sys/types.h>
+#include "input/parser.h"
+
+// Returned by a builtin that leaves this particular command to the
+// external program of the same name.
+#define RUN_EXTERNAL (-2)
+
+int is_builtin(const char *name);
+
+// Parses and runs a full command line (used for commands taken from history).
 void execute_cmd(char *line, int is_background);
-int dispatch_command(char *command_segment, int is_background);
+// Runs a single command that is not part of a pipeline; returns its exit status.
+int dispatch_command(const SimpleCommand *cmd, int is_background, const char *job_text);
+
+// Starts one stage of a pipeline with the given pipe ends (-1 for none) in
+// process group pgid (0 to lead a new group). Returns the pid, or -1.
+pid_t launch_pipeline_stage(const SimpleCommand *cmd, int in_fd, int out_fd, pid_t pgid, int foreground);
 
-#endif // CMD_EXEC_H
\ No newline at end of file
+#endif // CMD_EXEC_H
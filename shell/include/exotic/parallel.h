@@ -0,0 +1,7 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// parallel [-j N] [-k] [-n MAX] [-a FILE] [CMD [ARGS...]]
+int parallel_command(int argc, char **argv);
+
+#endif // PARALLEL_H
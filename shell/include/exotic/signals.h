@@ -1,10 +1,20 @@
 #ifndef SIGNALS_H
 #define SIGNALS_H
 
+#include <signal.h>
 #include <sys/types.h>
 
 extern volatile pid_t g_foreground_pgid;
+extern volatile sig_atomic_t g_sigint_pending;
 
 void init_signal_handlers(void);
 
-#endif // SIGNALS_H
\ No newline at end of file
+// While enabled (the shell is waiting for input), SIGINT and SIGTSTP are
+// blocked and queue up on signals_fd() instead of running the handlers.
+// Turning it off discards whatever is still queued.
+void signals_to_fd(int enabled);
+int signals_fd(void); // -1 unless init_signal_handlers has run
+// Takes one signal off signals_fd(): its number, or 0 if none is queued.
+int read_signal(void);
+
+#endif // SIGNALS_H
@@ -0,0 +1,17 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "input/parser.h"
+
+// Whether a foreground pipeline starts with "time" or "bench". A background
+// one is left alone, so time(1) can run it.
+int has_timing_prefix(const Pipeline *pipeline);
+
+// time PIPELINE: runs it and reports wall, user and sys time, peak RSS and
+// context switches on stderr.
+// bench -n N [-w W] PIPELINE: runs it W times untimed, then N times, and
+// reports the spread of the wall times.
+// Returns the exit status of the (last) run.
+int run_timed(const Pipeline *pipeline);
+
+#endif // TIMING_H
@@ -0,0 +1,8 @@
+#ifndef WAIT_H
+#define WAIT_H
+
+// wait [-n] [--timeout ms] [%job ...]: waits for the given jobs (all jobs
+// if none are given) to finish, or with -n for the first of them.
+int wait_command(int argc, char **argv);
+
+#endif // WAIT_H
@@ -0,0 +1,21 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+// Whether stdin and stdout are a terminal the editor can drive. The first
+// call sets the editor up.
+int editor_available(void);
+
+// Reads one line in raw mode through the event loop, after main has shown
+// the prompt. Returns the line without its newline, valid until the next
+// call, or NULL at end of input (Ctrl+D on an empty line).
+char *editor_read_line(void);
+
+// Take the prompt and the line being typed off the screen, and put them
+// back, so that other output can appear above them. No-ops when no line
+// is being edited.
+void editor_hide(void);
+void editor_show(void);
+
+void cleanup_editor(void);
+
+#endif // EDITOR_H
@@ -1,6 +1,22 @@
 #ifndef INPUT_H
 #define INPUT_H
 
+#include <stddef.h>
+#include <signal.h>
+
 char *read_input();
 
+// Script input for `shell.out FILE` and `shell.out -c CMD`. The whole text
+// is mapped (or read) once and handed out a line at a time; each line is
+// copied into the line arena, like read_input valid until the next reset.
+int open_script(const char *path);
+void open_script_string(const char *text);
+char *read_script_line(void);
+void close_script(void);
+
+// Reads fd to the end into a malloc'd buffer in large blocks; the caller
+// frees it. Stops with EINTR once *stop is set, if stop is not NULL.
+// Returns NULL with errno set on error.
+char *read_whole_fd(int fd, size_t *size, volatile sig_atomic_t *stop);
+
 #endif
@@ -0,0 +1,18 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+// Called when a watched fd is readable.
+typedef void (*EventHandler)(void *arg);
+
+// Watches fd for input (level-triggered) until loop_unwatch. Returns 0,
+// or -1 if the fd cannot be watched (e.g. a regular file).
+int loop_watch(int fd, EventHandler fn, void *arg);
+void loop_unwatch(int fd);
+
+// Waits up to timeout_ms (-1: no limit) for events and runs their
+// handlers. Returns the number of events handled, or -1 on error.
+int loop_run_once(int timeout_ms);
+
+void cleanup_loop(void);
+
+#endif // LOOP_H
@@ -1,6 +1,38 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-int parse_command(const char *line);
+typedef enum { REDIR_INPUT, REDIR_OUTPUT, REDIR_APPEND } RedirType;
+
+typedef struct {
+    RedirType type;
+    char *target;
+} Redirection;
+
+// A single command with its arguments, e.g. "wc -l < file".
+typedef struct {
+    char **argv;         // NULL-terminated
+    int argc;
+    Redirection *redirs; // In source order
+    int nredirs;
+} SimpleCommand;
+
+// Commands joined by '|', run together as one job.
+typedef struct {
+    SimpleCommand *cmds;
+    int ncmds;
+    int is_background;   // Followed by '&'
+    char *text;          // Source text of the pipeline, used for the job list
+} Pipeline;
+
+// A whole input line: pipelines separated by ';' or '&'.
+typedef struct {
+    Pipeline *pipelines;
+    int npipelines;
+} CommandLine;
+
+// Lexes and parses line in a single pass.
+// Returns the command tree, allocated in the line arena, or NULL if the
+// line is not valid syntax.
+CommandLine *parse_command(const char *line);
 
 #endif
@@ -1,7 +1,12 @@
 #ifndef PROMPT_H
 #define PROMPT_H
 
+#include <stddef.h>
+
 void init_prompt();
 void show_prompt();
+void invalidate_prompt(); // Call after the working directory changes
+// The prompt show_prompt would print, rebuilt first if it is stale.
+const char *current_prompt(size_t *len);
 
 #endif
@@ -0,0 +1,8 @@
+#ifndef CAT_H
+#define CAT_H
+
+// cat [FILE...]: copies the files (or stdin, for none or "-") to stdout in
+// the shell itself. Anything it does not handle runs /bin/cat instead.
+int cat_command(int argc, char **argv);
+
+#endif
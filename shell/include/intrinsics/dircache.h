@@ -0,0 +1,22 @@
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <stddef.h>
+
+typedef struct CachedDir CachedDir;
+
+// The sorted listing (dotfiles included) of the directory open on dir_fd,
+// from the cache while the directory is unchanged. The listing stays valid
+// until dircache_release(). Returns NULL on error, with errno set.
+CachedDir *dircache_get(int dir_fd);
+char *const *dircache_names(const CachedDir *dir, size_t *count);
+void dircache_release(CachedDir *dir);
+
+// Whether the directory open on dir_fd has an entry called name: 1 or 0,
+// or -1 if it could not be listed.
+int dircache_contains(int dir_fd, const char *name);
+
+int cache_command(int argc, char **argv);
+void cleanup_dircache();
+
+#endif // DIRCACHE_H
@@ -0,0 +1,11 @@
+#ifndef HASH_H
+#define HASH_H
+
+// Resolves a command name to the absolute path of its executable, using the
+// shell's command hash table. Names containing '/' are returned unchanged.
+// Returns NULL if the command cannot be found in $PATH.
+const char *lookup_command_path(const char *name);
+int hash_command(int argc, char **argv);
+void cleanup_hash();
+
+#endif
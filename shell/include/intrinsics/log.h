@@ -5,6 +5,7 @@ void init_log();
 void add_to_log(const char *cmd);
 int log_command(int argc, char **argv);
 void cleanup_log();
-char* process_log_execute(const char* line);
+// Expands "log execute <n>" references; the result lives in the line arena.
+const char* process_log_execute(const char* line);
 
 #endif
\ No newline at end of file
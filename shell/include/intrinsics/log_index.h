@@ -0,0 +1,26 @@
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef struct {
+    const char *text;    // Points into the mapped history file
+    uint32_t len;
+    uint32_t count;      // Times the command was run
+} LogMatch;
+
+// Brings the search index up to date with the history file mapped at map
+// (records from data_start to size). Only records appended since the last
+// call are read; a different file (dev, ino), a shrunk one, or one whose
+// last indexed record has moved (purged and refilled) is re-indexed.
+void log_index_sync(const char *map, size_t size, size_t data_start, dev_t dev, ino_t ino);
+
+// Finds up to limit commands containing pattern (or starting with it, if
+// prefix is set), most relevant first. Returns the number found.
+int log_index_search(const char *pattern, int prefix, LogMatch *out, int limit);
+
+void log_index_free(void);
+
+#endif // LOG_INDEX_H
@@ -1,6 +1,33 @@
 #ifndef REVEAL_H
 #define REVEAL_H
 
+#include <stddef.h>
+#include "arena.h"
+
 int reveal_command(int argc, char **argv);
 
-#endif
\ No newline at end of file
+// Names of one directory, packed into the arena's blocks.
+typedef struct {
+    Arena arena;         // Owns the name blocks
+    char *block;         // Block names are currently packed into
+    size_t block_room;
+    char **names;
+    size_t count;
+    size_t cap;
+    char *dirent_buf;    // getdents64 buffer, kept across resets
+} NameList;
+
+// The d_type getdents64 reported for a name in a NameList.
+#define NAME_TYPE(name) ((unsigned char)(name)[-1])
+
+// Reads every entry of the directory open on fd, skipping dotfiles unless
+// show_all is set. Returns -1 with errno set on failure.
+int read_names(int fd, int show_all, NameList *list);
+// Empties list but keeps its memory for the next directory.
+void reset_names(NameList *list);
+void free_names(NameList *list);
+
+// Sorts names that share their first depth bytes into strcmp order.
+void radix_sort(char **names, size_t count, size_t depth);
+
+#endif
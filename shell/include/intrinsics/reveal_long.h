@@ -0,0 +1,50 @@
+#ifndef REVEAL_LONG_H
+#define REVEAL_LONG_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+typedef struct {
+    char *name;
+    mode_t mode;
+    nlink_t nlink;
+    uid_t uid;
+    gid_t gid;
+    off_t size;
+    blkcnt_t blocks;
+    struct timespec mtime;
+    int ok;              // The entry could be stat'ed
+} FileInfo;
+
+// Fetches the metadata of count names in the directory open on dir_fd,
+// several at a time. Returns a malloc'd array in the order of names.
+FileInfo *stat_names(int dir_fd, char **names, size_t count);
+
+// Orders info by size or by modification time, biggest or newest first,
+// keeping the current (name) order among equals.
+void sort_by_info(FileInfo *info, size_t count, int by_time);
+
+// Output assembled in memory (fd = -1), or written to fd each time the
+// buffer fills up. A failed write or allocation sets failed.
+typedef struct {
+    char *data;
+    size_t used;
+    size_t cap;
+    int fd;
+    int failed;
+} OutBuf;
+
+void out_init(OutBuf *out, int fd);
+void out_append(OutBuf *out, const char *s, size_t n);
+void out_printf(OutBuf *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+// Flushes an fd-backed buffer and frees it; in-memory data is left to the
+// caller. Returns -1 if anything failed.
+int out_finish(OutBuf *out);
+
+// Appends an ls -l style listing of info to out.
+void format_long(OutBuf *out, int dir_fd, const FileInfo *info, size_t count);
+// Writes that listing to stdout.
+int write_long(int dir_fd, const FileInfo *info, size_t count);
+
+#endif // REVEAL_LONG_H
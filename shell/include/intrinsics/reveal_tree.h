@@ -0,0 +1,10 @@
+#ifndef REVEAL_TREE_H
+#define REVEAL_TREE_H
+
+// Lists root and every directory below it, like ls -R. layout is 0 for
+// names on one line, 'l' for one per line, 'L' for the long format;
+// sort_key is 0 for name order, 'S' for size or 't' for modification time.
+// REVEAL_THREADS sets the number of walker threads.
+int reveal_tree(const char *root, int show_all, int layout, char sort_key);
+
+#endif // REVEAL_TREE_H
@@ -1,8 +1,14 @@
 #ifndef EXECUTION_FLOW_H
 #define EXECUTION_FLOW_H
 
-// The main entry point for processing a user's command line.
+#include "input/parser.h"
+
+// The main entry point for running a parsed command line.
 // It handles sequential (;) and background (&) operators.
-void handle_execution_flow(char *line);
+// Returns the exit status of the last pipeline run.
+int handle_execution_flow(const CommandLine *cmdline);
+// Runs one pipeline (a single command, or stages joined by '|') and returns
+// its exit status, 0 if it was sent to the background.
+int run_pipeline(const Pipeline *pipeline);
 
-#endif // EXECUTION_FLOW_H
\ No newline at end of file
+#endif // EXECUTION_FLOW_H
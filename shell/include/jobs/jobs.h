@@ -1,32 +1,84 @@
 #ifndef JOBS_H
 #define JOBS_H
 
+#include <signal.h>
 #include <sys/types.h>
-
-#define MAX_JOBS 64
-#define MAX_CMD_LEN 256
+#include <sys/resource.h>
 
 typedef enum { RUNNING, STOPPED, TERMINATED } JobStatus;
 
-typedef struct {
+typedef struct Job {
     pid_t pid;
     pid_t pgid;
     int job_id;
-    char command[MAX_CMD_LEN];
+    const char *command; // Interned; jobs with the same text share it
     JobStatus status;
+    pid_t *members;      // Process of each pipeline stage, 0 once reaped
+    int *stage_status;   // Wait status of each stage, valid once reaped
+    int nmembers;
+    int live_members;    // Members not yet reaped
+    struct Job *prev;    // Neighbours in creation (job id) order
+    struct Job *next;
 } Job;
 
 void init_jobs(void);
-void add_job(pid_t pgid, const char* command, JobStatus initial_status);
+// Registers a job made of the given pipeline stages (all in process group
+// pgid). A pid of 0 marks a stage that was already reaped, with its wait
+// status in statuses[i]; statuses may be NULL if every stage is alive.
+void add_job(pid_t pgid, const pid_t *pids, const int *statuses, int npids,
+             const char* command, JobStatus initial_status);
+// Waits on a foreground process group until every stage in pids has exited
+// or the job is stopped. Reaped stages are set to 0 and their wait status
+// stored in statuses. Returns 1 if the job stopped, 0 if it finished.
+int wait_for_stages(pid_t pgid, pid_t *pids, int *statuses, int npids);
+// Blocks until a child that is not part of any job exits or stops, and
+// returns its pid. Job members reaped on the way update the job list as
+// check_jobs does. Returns -1 when there are no children left.
+pid_t wait_any_child(int *status);
+// Waits on a job being brought to the foreground by polling pidfds of its
+// members. A finished job is removed from the list. Returns 1 if the job
+// stopped again.
+int wait_for_job(Job *job);
+// Waits for the jobs with the given ids to finish: all of them, or only the
+// first if any is set. timeout_ms < 0 means no limit. Finished jobs are
+// reported like background ones. Returns 0 with the exit status of the last
+// job listed (or the first to finish) in *status, 1 on timeout, or -1 once
+// a signal interrupts the wait with *stop set.
+int wait_for_jobs(const int *ids, int n, int any, int timeout_ms,
+                  volatile sig_atomic_t *stop, int *status);
+// Signal a job or a single process without ever hitting a pid the kernel
+// has since reused. Return -1 with errno set on failure.
+int signal_job(Job *job, int sig);
+int signal_pid(pid_t pid, int sig);
 void check_jobs(void);
 void print_completed_jobs(void);
+// Whether print_completed_jobs has anything to print.
+int has_completed_jobs(void);
 void cleanup_jobs(void);
 void kill_all_jobs(void);
-int get_job_list(Job job_snapshot[MAX_JOBS]);
+// A signalfd that becomes readable when a child changes state.
+int jobs_signal_fd(void);
+
+// Job control (own process groups, terminal handoff) is on by default and
+// turned off for scripts and -c, where children stay in the shell's group.
+void set_job_control(int enabled);
+int job_control_enabled(void);
+// While set, the resource usage of every child reaped by a foreground wait
+// (wait_for_stages, wait_for_job, wait_any_child) is added to *usage: times
+// and counters summed, ru_maxrss the largest. Returns the previous sink.
+struct rusage *collect_child_usage(struct rusage *usage);
+// Shell-style exit status for a wait status: the exit code, or 128 + the
+// number of the signal that killed or stopped the process.
+int exit_status(int wait_status);
+
+// Iterates the live jobs oldest first: for (Job *j = first_job(); j; j = j->next).
+// The list must not be modified while iterating.
+Job* first_job(void);
+int job_count(void);
 
 // --- NEW FUNCTIONS ---
 Job* find_job_by_id(int job_id);
 Job* find_most_recent_job(void);
 int remove_job_by_pgid(pid_t pgid);
 
-#endif // JOBS_H
\ No newline at end of file
+#endif // JOBS_H
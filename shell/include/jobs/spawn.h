@@ -0,0 +1,32 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include <sys/types.h>
+#include "input/parser.h"
+
+// Describes how a child process should be set up before it runs.
+typedef struct {
+    const Redirection *redirs; // Applied in order; the last one per stream wins
+    int nredirs;
+    int in_fd;                 // Pipe end to use as stdin, or -1
+    int out_fd;                // Pipe end to use as stdout, or -1
+    pid_t pgid;                // Process group to join, 0 to lead a new one,
+                               // -1 to stay in the shell's group
+    int foreground;            // Hand the terminal to the child's process group
+} LaunchSpec;
+
+// Launches the executable at path with posix_spawn (clone(CLONE_VM|CLONE_VFORK)
+// under glibc), so the cost does not grow with the shell's memory size.
+// argv and the environment are checked against sysconf(_SC_ARG_MAX) first.
+// Returns the child's pid, or -1 if nothing was started (error already printed).
+pid_t spawn_external(const char *path, char **argv, const LaunchSpec *spec);
+
+// Bytes left for argv under sysconf(_SC_ARG_MAX) once the environment is
+// counted, each argument costing strlen + 1 plus its pointer; -1 if unlimited.
+long exec_arg_room(void);
+
+// Fallback launcher: forks a child set up like spawn_external and runs
+// body(arg) in it; the child exits with its return value.
+pid_t fork_process(const LaunchSpec *spec, int (*body)(void *), void *arg);
+
+#endif // SPAWN_H
@@ -0,0 +1,52 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+// Counters, gauges and latency histograms for a long-running shell.
+// Updates are single atomic operations, so the exporter thread can read
+// them while the shell runs, with no locks on either side.
+
+typedef enum {
+    METRIC_COMMANDS,       // Pipelines and single commands run
+    METRIC_BUILTINS,       // Builtins run, in the shell or forked
+    METRIC_EXTERNALS,      // External programs started
+    METRIC_JOBS,           // Jobs in the job table
+    METRIC_HISTORY_BYTES,  // Size of the history file
+    METRIC_ARENA_BYTES,    // Bytes held by the line arena
+    METRIC_ARENA_ALLOCATIONS, // Blocks the line arena has handed out
+    METRIC_ARENA_HEAP_CALLS,  // malloc() calls the line arena made for chunks
+    METRIC_COUNT
+} MetricId;
+
+typedef enum {
+    HISTOGRAM_SPAWN,       // Time to start a process (posix_spawn or fork)
+    HISTOGRAM_COUNT
+} HistogramId;
+
+void metric_add(MetricId id, long delta);
+void metric_set(MetricId id, long value);
+// Records a duration measured with metric_now().
+void metric_observe(HistogramId id, long long ns);
+long long metric_now(void);
+
+// Writes every metric in OpenMetrics text format.
+void write_metrics(FILE *f);
+
+// Rewrites path every interval_s seconds from a background thread; each
+// version replaces the last with rename(), so readers never see half a
+// file. A relative path is resolved once, against the current directory.
+// Returns -1 if the first write fails (printed).
+int metrics_export_start(const char *path, int interval_s);
+void metrics_export_stop(void);
+
+// Starts exporting if $SHELL_METRICS names a file ($SHELL_METRICS_INTERVAL
+// seconds apart, 10 by default).
+void init_metrics(void);
+// Stops the exporter after a last write.
+void cleanup_metrics(void);
+
+// stats | stats export FILE [SECONDS] | stats export off
+int stats_command(int argc, char **argv);
+
+#endif // METRICS_H
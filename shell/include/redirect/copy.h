@@ -0,0 +1,13 @@
+#ifndef COPY_H
+#define COPY_H
+
+#include <signal.h>
+
+// Copies everything from in_fd to out_fd, keeping the data in the kernel
+// where it can: copy_file_range between regular files, splice when either
+// side is a pipe, sendfile from a regular file, and read/write otherwise.
+// Stops with EINTR once *stop is set, if stop is not NULL.
+// Returns 0, or -1 with errno set.
+int copy_fd(int in_fd, int out_fd, volatile sig_atomic_t *stop);
+
+#endif
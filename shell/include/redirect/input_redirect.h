@@ -1,6 +1,10 @@
 #ifndef INPUT_REDIRECT_H
 #define INPUT_REDIRECT_H
 
+// Opens file for reading (close-on-exec) without touching stdin
+// Returns the fd, or -1 on failure (and prints error)
+int open_input_file(const char *filename);
+
 // Redirects stdin from file
 // Returns 0 on success, -1 on failure (and prints error)
 int handle_input_redirection(const char *filename);
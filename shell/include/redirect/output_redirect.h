@@ -1,6 +1,10 @@
 #ifndef OUTPUT_REDIRECT_H
 #define OUTPUT_REDIRECT_H
 
+// Opens file for writing (close-on-exec) without touching stdout
+// Returns the fd, or -1 on failure (and prints error)
+int open_output_file(const char *filename, int append);
+
 // Redirects stdout to file
 // append = 0 → overwrite (>), append = 1 → append (>>)
 // Returns 0 on success, -1 on failure (and prints error)
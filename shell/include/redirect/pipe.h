@@ -1,7 +1,10 @@
-#ifndef PIPE__H
+#ifndef PIPE_H
 #define PIPE_H
 
+#include "input/parser.h"
+
 // Execute a full pipeline, including redirections if present.
-void execute_pipeline(char *line, int is_background);
+// Returns the exit status of the last stage (0 for a background pipeline).
+int execute_pipeline(const Pipeline *pipeline);
 
 #endif
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Opt-in tracing of where a command's time goes. Spans are timed with
+// CLOCK_MONOTONIC, kept in a ring buffer per thread, and written out as
+// Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+//
+//   long long t = trace_begin();
+//   ...
+//   trace_end(t, "parse", line);
+//
+// While tracing is off a span costs one load and a branch.
+
+extern int trace_active;
+
+long long trace_clock(void);
+void trace_record(long long start, const char *name, const char *detail);
+
+static inline long long trace_begin(void) {
+    return trace_active ? trace_clock() : 0;
+}
+
+// name must be a string literal; detail (may be NULL) is copied, truncated.
+static inline void trace_end(long long start, const char *name, const char *detail) {
+    if (start) trace_record(start, name, detail);
+}
+
+// Starts tracing to path (written when tracing stops), or stops and writes
+// the file. Return -1 on error, printed.
+int trace_start(const char *path);
+int trace_stop(void);
+
+// Starts tracing if $SHELL_TRACE names a file.
+void init_trace(void);
+// Writes the trace if one is running and frees the buffers.
+void cleanup_trace(void);
+
+// trace on FILE | trace off | trace
+int trace_command(int argc, char **argv);
+
+#endif // TRACE_H
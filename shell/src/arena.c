@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_CHUNK_SIZE (16 * 1024)
+#define ARENA_ALIGN 16
+
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t size;
+    size_t used;
+    size_t last;   // Offset of the most recent block, for in-place growth
+    unsigned char data[];
+};
+
+Arena line_arena = { NULL, NULL, { 0, 0, 0, 0, 0 } };
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static ArenaChunk *new_chunk(Arena *arena, size_t min_size) {
+    size_t size = min_size > ARENA_CHUNK_SIZE ? align_up(min_size) : ARENA_CHUNK_SIZE;
+    ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + size);
+    if (!chunk) return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->last = 0;
+    arena->stats.heap_calls++;
+    arena->stats.reserved += size;
+    return chunk;
+}
+
+// Finds room for size bytes: the current chunk, then the ones left over from
+// earlier (reset) lines, and only then a freshly malloc'd chunk.
+static ArenaChunk *chunk_with_room(Arena *arena, size_t size) {
+    ArenaChunk *chunk = arena->current;
+    if (chunk && chunk->size - chunk->used >= size) return chunk;
+
+    while (chunk && chunk->next) {
+        chunk = chunk->next;
+        chunk->used = 0;
+        chunk->last = 0;
+        arena->current = chunk;
+        if (chunk->size >= size) return chunk;
+    }
+
+    ArenaChunk *fresh = new_chunk(arena, size);
+    if (!fresh) return NULL;
+    if (!arena->first) {
+        arena->first = fresh;
+    } else {
+        fresh->next = arena->current->next;
+        arena->current->next = fresh;
+    }
+    arena->current = fresh;
+    return fresh;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = align_up(size ? size : 1);
+    ArenaChunk *chunk = chunk_with_room(arena, size);
+    if (!chunk) {
+        perror("malloc");
+        return NULL;
+    }
+    void *p = chunk->data + chunk->used;
+    chunk->last = chunk->used;
+    chunk->used += size;
+    arena->stats.allocations++;
+    arena->stats.bytes += size;
+    return p;
+}
+
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (!ptr) return arena_alloc(arena, new_size);
+
+    ArenaChunk *chunk = arena->current;
+    if (chunk && (unsigned char *)ptr == chunk->data + chunk->last &&
+        chunk->last + align_up(new_size) <= chunk->size) {
+        size_t grown = align_up(new_size);
+        if (grown > chunk->used - chunk->last) arena->stats.bytes += grown - (chunk->used - chunk->last);
+        chunk->used = chunk->last + grown;
+        return ptr;
+    }
+
+    void *p = arena_alloc(arena, new_size);
+    if (p) memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+    return p;
+}
+
+char *arena_strndup(Arena *arena, const char *s, size_t n) {
+    char *copy = arena_alloc(arena, n + 1);
+    if (!copy) return NULL;
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *s) {
+    return arena_strndup(arena, s, strlen(s));
+}
+
+void arena_reset(Arena *arena) {
+    arena->current = arena->first;
+    if (arena->first) {
+        arena->first->used = 0;
+        arena->first->last = 0;
+    }
+    arena->stats.resets++;
+}
+
+void arena_destroy(Arena *arena) {
+    ArenaChunk *chunk = arena->first;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->first = arena->current = NULL;
+    arena->stats.reserved = 0;
+}
+
+const ArenaStats *arena_stats(const Arena *arena) {
+    return &arena->stats;
+}
@@ -3,157 +3,220 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <signal.h>
 #include <sys/wait.h>
 
 #include "cmd_exec.h"
 #include "intrinsics/hop.h"
 #include "intrinsics/reveal.h"
 #include "intrinsics/log.h"
+#include "intrinsics/hash.h"
+#include "intrinsics/dircache.h"
+#include "intrinsics/cat.h"
 #include "exotic/activities.h"
 #include "exotic/ping.h"
 #include "exotic/signals.h"
 #include "exotic/fg.h"
 #include "exotic/bg.h"
+#include "exotic/wait.h"
+#include "exotic/parallel.h"
 #include "jobs/jobs.h"
 #include "redirect/input_redirect.h"
 #include "redirect/output_redirect.h"
 #include "redirect/pipe.h"
+#include "jobs/spawn.h"
+#include "jobs/execution.h"
+#include "arena.h"
+#include "trace.h"
+#include "metrics.h"
 
-// This is the function that launches a single, non-piped command.
-int dispatch_command(char *command_segment, int is_background) {
-    char *args[64];
-    int argc = 0;
-    char *input_file = NULL;
-    char *output_file = NULL;
-    int append_mode = 0;
-    
-    // Create a pristine copy for the job list and a mutable copy for strtok
-    char *full_command_for_job = strdup(command_segment);
-    char *command_copy = strdup(command_segment);
-
-    char *tok = strtok(command_copy, " \t\n");
-    if (!tok) {
-        free(command_copy);
-        free(full_command_for_job);
-        return 0;
+typedef int (*BuiltinFn)(int argc, char **argv);
+
+typedef struct {
+    const char *name;
+    BuiltinFn fn;
+    int shadows_program; // Stands in for an executable, which runs with '&'
+} Builtin;
+
+static const Builtin builtins[] = {
+    {"hop", hop_command, 0},
+    {"reveal", reveal_command, 0},
+    {"log", log_command, 0},
+    {"activities", activities_command, 0},
+    {"ping", ping_command, 0},
+    {"fg", fg_command, 0},
+    {"bg", bg_command, 0},
+    {"wait", wait_command, 0},
+    {"trace", trace_command, 0},
+    {"stats", stats_command, 0},
+    {"hash", hash_command, 0},
+    {"parallel", parallel_command, 0},
+    {"cache", cache_command, 0},
+    {"cat", cat_command, 1},
+};
+
+typedef struct {
+    BuiltinFn fn;
+    int argc;
+    char **argv;
+} BuiltinCall;
+
+static const Builtin *lookup_builtin(const char *name) {
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        if (strcmp(builtins[i].name, name) == 0) return &builtins[i];
     }
+    return NULL;
+}
+
+static BuiltinFn find_builtin(const char *name) {
+    const Builtin *b = lookup_builtin(name);
+    return b ? b->fn : NULL;
+}
+
+int is_builtin(const char *name) {
+    return find_builtin(name) != NULL;
+}
+
+extern char **environ;
 
-    char *cmd = tok;
-    args[argc++] = cmd;
-
-    while ((tok = strtok(NULL, " \t\n"))) {
-        if (strcmp(tok, "<") == 0) {
-            input_file = strtok(NULL, " \t\n"); // Always use the last input redirection
-        } else if (strcmp(tok, ">") == 0) {
-            output_file = strtok(NULL, " \t\n"); // Always use the last output redirection
-            append_mode = 0;
-        } else if (strcmp(tok, ">>") == 0) {
-            output_file = strtok(NULL, " \t\n"); // Always use the last output redirection
-            append_mode = 1;
+static int run_builtin_body(void *arg) {
+    BuiltinCall *call = arg;
+    int result = call->fn(call->argc, call->argv);
+    if (result != RUN_EXTERNAL) return result;
+
+    // Already in the child with its fds in place: become the program.
+    const char *path = lookup_command_path(call->argv[0]);
+    if (path) execve(path, call->argv, environ);
+    printf("Command not found!\n");
+    return 127;
+}
+
+// Applies cmd's redirections to the shell's own stdin/stdout, in order, for a
+// builtin. The originals are saved in *saved_in / *saved_out for restore_stdio.
+static int redirect_builtin(const SimpleCommand *cmd, int *saved_in, int *saved_out) {
+    *saved_in = *saved_out = -1;
+    for (int i = 0; i < cmd->nredirs; i++) {
+        const Redirection *r = &cmd->redirs[i];
+        if (r->type == REDIR_INPUT) {
+            if (*saved_in == -1) *saved_in = dup(STDIN_FILENO);
+            if (handle_input_redirection(r->target) < 0) return -1;
         } else {
-            args[argc++] = tok;
+            if (*saved_out == -1) *saved_out = dup(STDOUT_FILENO);
+            if (handle_output_redirection(r->target, r->type == REDIR_APPEND) < 0) return -1;
         }
     }
-    args[argc] = NULL;
-
-    int is_intrinsic = (strcmp(cmd, "hop") == 0) || (strcmp(cmd, "reveal") == 0) ||
-                       (strcmp(cmd, "log") == 0) || (strcmp(cmd, "activities") == 0) ||
-                       (strcmp(cmd, "ping") == 0) || (strcmp(cmd, "fg") == 0) ||
-                       (strcmp(cmd, "bg") == 0);
-
-    if (is_intrinsic) {
-        int original_stdin = -1, original_stdout = -1;
-        int result = 0;
-
-        if (input_file) {
-            original_stdin = dup(STDIN_FILENO);
-            if (handle_input_redirection(input_file) < 0) {
-                if (original_stdin != -1) close(original_stdin);
-                free(command_copy);
-                free(full_command_for_job);
-                return -1;
-            }
-        }
-        if (output_file) {
-            original_stdout = dup(STDOUT_FILENO);
-            if (handle_output_redirection(output_file, append_mode) < 0) {
-                if (original_stdout != -1) close(original_stdout);
-                if (original_stdin != -1) {
-                    dup2(original_stdin, STDIN_FILENO);
-                    close(original_stdin);
-                }
-                free(command_copy);
-                free(full_command_for_job);
-                return -1;
-            }
-        }
+    return 0;
+}
 
-        if (strcmp(cmd, "hop") == 0) result = hop_command(argc, args);
-        else if (strcmp(cmd, "reveal") == 0) result = reveal_command(argc, args);
-        else if (strcmp(cmd, "log") == 0) result = log_command(argc, args);
-        else if (strcmp(cmd, "activities") == 0) result = activities_command(argc, args);
-        else if (strcmp(cmd, "ping") == 0) result = ping_command(argc, args);
-        else if (strcmp(cmd, "fg") == 0) result = fg_command(argc, args);
-        else if (strcmp(cmd, "bg") == 0) result = bg_command(argc, args);
-
-        if (original_stdin != -1) {
-            dup2(original_stdin, STDIN_FILENO);
-            close(original_stdin);
-        }
-        if (original_stdout != -1) {
-            dup2(original_stdout, STDOUT_FILENO);
-            close(original_stdout);
-        }
+static void restore_stdio(int saved_in, int saved_out) {
+    if (saved_in != -1) {
+        dup2(saved_in, STDIN_FILENO);
+        close(saved_in);
+    }
+    if (saved_out != -1) {
+        fflush(stdout);
+        dup2(saved_out, STDOUT_FILENO);
+        close(saved_out);
+    }
+}
+
+// This is the function that launches a single, non-piped command.
+// job_text is the command as typed, used if it ends up in the job list.
+// Returns the command's exit status (0 for one sent to the background).
+int dispatch_command(const SimpleCommand *cmd, int is_background, const char *job_text) {
+    if (cmd->argc == 0) return 0;
 
-        free(command_copy);
-        free(full_command_for_job);
-        return result;
+    char **args = cmd->argv;
+    const Builtin *entry = lookup_builtin(args[0]);
+    // Builtins run inside the shell, which would block on a background one;
+    // those standing in for a program leave it to the program, as a job.
+    BuiltinFn builtin = entry && !(is_background && entry->shadows_program) ? entry->fn : NULL;
+
+    if (builtin) {
+        int original_stdin, original_stdout;
+        int result = 1;
+
+        long long span = cmd->nredirs ? trace_begin() : 0;
+        int redirected = redirect_builtin(cmd, &original_stdin, &original_stdout);
+        trace_end(span, "redirect", cmd->nredirs ? cmd->redirs[0].target : NULL);
+        if (redirected == 0) {
+            metric_add(METRIC_BUILTINS, 1);
+            span = trace_begin();
+            result = builtin(cmd->argc, args);
+            trace_end(span, "builtin", args[0]);
+        }
+        restore_stdio(original_stdin, original_stdout);
+        if (result != RUN_EXTERNAL) return result == 0 ? 0 : 1;
     }
 
     // --- External command logic ---
-    pid_t pid = fork();
-    if (pid == 0) { // Child process
-        setpgid(0, 0);
-        if (!is_background) { tcsetpgrp(STDIN_FILENO, getpgrp()); }
-        signal(SIGINT, SIG_DFL);
-        signal(SIGTSTP, SIG_DFL);
-        signal(SIGTTIN, SIG_DFL);
-        signal(SIGTTOU, SIG_DFL);
-        if (input_file && handle_input_redirection(input_file) < 0) exit(1);
-        if (output_file && handle_output_redirection(output_file, append_mode) < 0) exit(1);
-        execvp(cmd, args);
+    // Resolve the executable before spawning so the lookup is cached in the
+    // shell itself and a missing command never touches its redirection files.
+    const char *exec_path = lookup_command_path(args[0]);
+    if (!exec_path) {
         printf("Command not found!\n");
-        exit(127);
-    } else if (pid > 0) { // Parent process
-        if (is_background) {
-            // For background jobs, append " &" to the command for proper logging
-            char *bg_command = malloc(strlen(full_command_for_job) + 3);
-            sprintf(bg_command, "%s &", full_command_for_job);
-            add_job(pid, bg_command, RUNNING);
-            free(bg_command);
-        } else {
-            g_foreground_pgid = pid;
-            int status;
-            waitpid(pid, &status, WUNTRACED);
-            if (WIFSTOPPED(status)) {
-                add_job(pid, full_command_for_job, STOPPED);
-            }
-            tcsetpgrp(STDIN_FILENO, getpgrp());
-            g_foreground_pgid = 0;
+        return 127;
+    }
+
+    LaunchSpec spec = { cmd->redirs, cmd->nredirs, -1, -1, 0, !is_background };
+    pid_t pid = spawn_external(exec_path, args, &spec);
+    if (pid < 0) return 1;
+
+    if (is_background) {
+        // For background jobs, append " &" to the command for proper logging
+        size_t text_len = strlen(job_text);
+        char *bg_command = arena_alloc(&line_arena, text_len + 3);
+        if (bg_command) {
+            memcpy(bg_command, job_text, text_len);
+            memcpy(bg_command + text_len, " &", 3);
         }
+        // The job is running either way; without memory it keeps the plain text.
+        add_job(pid, &pid, NULL, 1, bg_command ? bg_command : job_text, RUNNING);
+        return 0;
+    }
+
+    g_foreground_pgid = pid;
+    pid_t stage = pid;
+    int status = 0;
+    int result;
+    if (wait_for_stages(pid, &stage, &status, 1)) {
+        add_job(pid, &stage, &status, 1, job_text, STOPPED);
+        result = 128 + SIGTSTP;
     } else {
-        perror("fork");
+        result = exit_status(status);
     }
+    if (job_control_enabled()) tcsetpgrp(STDIN_FILENO, getpgrp());
+    g_foreground_pgid = 0;
+    return result;
+}
 
-    free(command_copy);
-    free(full_command_for_job);
-    return 0;
+pid_t launch_pipeline_stage(const SimpleCommand *cmd, int in_fd, int out_fd, pid_t pgid, int foreground) {
+    LaunchSpec spec = { cmd->redirs, cmd->nredirs, in_fd, out_fd, pgid, foreground };
+
+    BuiltinFn builtin = find_builtin(cmd->argv[0]);
+    if (builtin) {
+        // Builtins have no executable, so they keep the fork fallback.
+        metric_add(METRIC_BUILTINS, 1);
+        BuiltinCall call = { builtin, cmd->argc, cmd->argv };
+        return fork_process(&spec, run_builtin_body, &call);
+    }
+
+    const char *exec_path = lookup_command_path(cmd->argv[0]);
+    if (!exec_path) {
+        printf("Command not found!\n");
+        return -1;
+    }
+    return spawn_external(exec_path, cmd->argv, &spec);
 }
 
 void execute_cmd(char *line, int is_background) {
-    if (strchr(line, '|')) {
-        execute_pipeline(line, is_background);
-    } else {
-        dispatch_command(line, is_background);
+    CommandLine *cmdline = parse_command(line);
+    if (!cmdline) {
+        printf("Invalid Syntax!\n");
+        return;
     }
-}
\ No newline at end of file
+    for (int i = 0; i < cmdline->npipelines; i++) {
+        if (is_background) cmdline->pipelines[i].is_background = 1;
+    }
+    handle_execution_flow(cmdline);
+}
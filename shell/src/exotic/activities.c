@@ -7,8 +7,8 @@
 
 // qsort comparator to sort jobs lexicographically by command name
 static int compare_jobs(const void *a, const void *b) {
-    Job *job_a = (Job *)a;
-    Job *job_b = (Job *)b;
+    const Job *job_a = *(const Job *const *)a;
+    const Job *job_b = *(const Job *const *)b;
     return strcmp(job_a->command, job_b->command);
 }
 
@@ -16,27 +16,34 @@ int activities_command(int argc, char **argv) {
     (void)argc; // Unused
     (void)argv; // Unused
 
-    // Get a snapshot of the current jobs
-    Job job_snapshot[MAX_JOBS];
-    int count = get_job_list(job_snapshot);
-
+    int count = job_count();
     if (count == 0) {
         return 0; // Nothing to print
     }
 
-    // Sort the snapshot
-    qsort(job_snapshot, count, sizeof(Job), compare_jobs);
+    // Sort pointers into the job list rather than copies of the jobs
+    Job **sorted = malloc(count * sizeof(Job *));
+    if (!sorted) {
+        perror("malloc");
+        return 1;
+    }
+    int n = 0;
+    for (Job *job = first_job(); job && n < count; job = job->next) {
+        sorted[n++] = job;
+    }
+    qsort(sorted, n, sizeof(Job *), compare_jobs);
 
     // Print sorted jobs
-    for (int i = 0; i < count; i++) {
+    for (int i = 0; i < n; i++) {
         const char *status_str = "Unknown";
-        if (job_snapshot[i].status == RUNNING) {
+        if (sorted[i]->status == RUNNING) {
             status_str = "Running";
-        } else if (job_snapshot[i].status == STOPPED) {
+        } else if (sorted[i]->status == STOPPED) {
             status_str = "Stopped";
         }
-        printf("[%d] : %s - %s\n", job_snapshot[i].pid, job_snapshot[i].command, status_str);
+        printf("[%d] : %s - %s\n", sorted[i]->pid, sorted[i]->command, status_str);
     }
 
+    free(sorted);
     return 0;
-}
\ No newline at end of file
+}
@@ -6,6 +6,11 @@
 #include <signal.h>
 
 int bg_command(int argc, char **argv) {
+    if (!job_control_enabled()) {
+        printf("bg: no job control\n");
+        return 1;
+    }
+
     if (argc != 2) {
         printf("bg: job number required\n");
         return 1;
@@ -25,8 +30,8 @@ int bg_command(int argc, char **argv) {
     }
 
     // Continue the stopped job in the background
-    if (kill(-job->pgid, SIGCONT) < 0) {
-        perror("bg: kill (SIGCONT)");
+    if (signal_job(job, SIGCONT) < 0) {
+        perror("bg: SIGCONT");
         return 1;
     }
 
@@ -6,10 +6,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
-#include <sys/wait.h>
-#include <errno.h>
 
 int fg_command(int argc, char **argv) {
+    if (!job_control_enabled()) {
+        printf("fg: no job control\n");
+        return 1;
+    }
+
     if (argc > 2) {
         printf("fg: too many arguments\n");
         return 1;
@@ -41,44 +44,25 @@ int fg_command(int argc, char **argv) {
 
     // If it's stopped, send the continue signal
     if (job->status == STOPPED) {
-        if (kill(-job->pgid, SIGCONT) < 0) {
-            perror("fg: kill (SIGCONT)");
+        if (signal_job(job, SIGCONT) < 0) {
+            perror("fg: SIGCONT");
             // On failure, give terminal control back to the shell
             tcsetpgrp(STDIN_FILENO, getpgrp());
             g_foreground_pgid = 0;
             return 1;
         }
-        // Conceptually, the job is now running
-        job->status = RUNNING;
     }
 
-    // Wait for the job to change state (terminate or stop)
-    int status;
-    pid_t result = waitpid(-job->pgid, &status, WUNTRACED);
+    // Wait until every stage has finished or the job is stopped again
+    int stopped = wait_for_job(job);
 
     // Take terminal control back for the shell
     tcsetpgrp(STDIN_FILENO, getpgrp());
     g_foreground_pgid = 0;
 
-    // Handle the final state of the job after it has run
-    if (result > 0) {
-        if (WIFSTOPPED(status)) {
-            // The job was stopped again. It's still in our list, so just update its status.
-            job->status = STOPPED;
-            printf("\n[%d] Stopped \t%s\n", job->job_id, job->command);
-        } else {
-            // The job terminated (exited or signaled). Remove it from the job list.
-            remove_job_by_pgid(job->pgid);
-        }
-    } else if (result < 0 && errno != ECHILD) {
-        // An actual error occurred with waitpid
-        perror("fg: waitpid");
-        // The job state is uncertain, but we should remove it to be safe
-        remove_job_by_pgid(job->pgid);
-    } else {
-        // waitpid returned 0 or -1 with ECHILD, meaning the job is gone.
-        // This can happen if it was killed by an external signal.
-        remove_job_by_pgid(job->pgid);
+    if (stopped) {
+        // The job was stopped again. It's still in our list with its new status.
+        printf("\n[%d] Stopped \t%s\n", job->job_id, job->command);
     }
 
     return 0;
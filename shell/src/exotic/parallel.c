@@ -0,0 +1,384 @@
+#define _POSIX_C_SOURCE 200809L
+#include "exotic/parallel.h"
+#include "cmd_exec.h"
+#include "input/input.h"
+#include "input/parser.h"
+#include "intrinsics/hash.h"
+#include "jobs/jobs.h"
+#include "redirect/copy.h"
+#include "jobs/spawn.h"
+#include "jobs/execution.h"
+#include "redirect/input_redirect.h"
+#include "arena.h"
+#include "exotic/signals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/wait.h>
+
+/*
+parallel reads one item per line from stdin (or -a FILE) and runs them as
+tasks, keeping at most -j of them alive at once. A slot is refilled as soon
+as wait_any_child reports a task finished; children that belong to jobs are
+handed to the job list on the way, so background jobs keep working.
+
+Without CMD every line is a command line, run by a forked copy of the shell
+with job control off. With CMD the lines become its arguments, packed like
+xargs into batches that stay under ARG_MAX (or at most -n per batch).
+
+Each task's stdout goes to an unlinked temporary file and is copied out in
+one piece when the task is printed, so the output of different tasks never
+interleaves: as they finish, or in input order with -k. With -k a finished
+task keeps its file until every task before it is printed, so no task is
+started more than MAX_HELD_OUTPUTS ahead of the oldest one still unprinted.
+
+With job control on, the running tasks share one foreground process group,
+led by the first of them, so Ctrl-C and Ctrl-Z reach them and not the shell.
+A task killed by SIGINT stops any more from being started. A stopped task
+would hold its slot forever, so a stop ends the batch instead: the running
+tasks get SIGTERM (SIGKILL if they stop again) and a SIGCONT to act on it.
+*/
+
+// Room left below ARG_MAX, as xargs does, for the kernel's own bookkeeping.
+#define ARG_HEADROOM 2048
+
+// Most tasks holding captured output at once under -k.
+#define MAX_HELD_OUTPUTS 64
+
+typedef struct {
+    char **argv;         // CMD mode: the command and its batch of arguments
+    int argc;
+    char *line;          // Line mode: a whole command line
+    const char *label;   // Shown when the task fails
+    pid_t pid;
+    FILE *output;        // Captured stdout, NULL if not captured
+    int status;          // Wait status once finished
+    int started;
+    int done;
+} Task;
+
+typedef struct {
+    int jobs;            // -j
+    int keep_order;      // -k
+    int max_args;        // -n, 0 for as many as fit
+    const char *arg_file; // -a
+    char **cmd;          // CMD ARGS..., NULL in line mode
+    int cmd_argc;
+} ParallelOptions;
+
+static double elapsed_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int parse_count(const char *value, int *out) {
+    char *end;
+    long n = strtol(value, &end, 10);
+    if (*end != '\0' || end == value || n < 1 || n > 1000000) {
+        printf("parallel: invalid number %s\n", value);
+        return -1;
+    }
+    *out = (int)n;
+    return 0;
+}
+
+static int parse_options(int argc, char **argv, ParallelOptions *opts) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    opts->jobs = cpus > 0 ? (int)cpus : 1;
+    opts->keep_order = 0;
+    opts->max_args = 0;
+    opts->arg_file = NULL;
+    opts->cmd = NULL;
+    opts->cmd_argc = 0;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+        const char *flag = argv[i];
+        if (strcmp(flag, "--") == 0) {
+            i++;
+            break;
+        }
+        if (strcmp(flag, "-k") == 0) {
+            opts->keep_order = 1;
+            continue;
+        }
+        char f = flag[1];
+        if (f != 'j' && f != 'n' && f != 'a') {
+            printf("parallel: Invalid flag %s\n", flag);
+            return -1;
+        }
+        const char *value = flag[2] ? flag + 2 : (i + 1 < argc ? argv[++i] : NULL);
+        if (!value) {
+            printf("parallel: option -%c requires an argument\n", f);
+            return -1;
+        }
+        if (f == 'a') {
+            opts->arg_file = value;
+        } else if (parse_count(value, f == 'j' ? &opts->jobs : &opts->max_args) < 0) {
+            return -1;
+        }
+    }
+    if (i < argc) {
+        opts->cmd = &argv[i];
+        opts->cmd_argc = argc - i;
+    }
+    return 0;
+}
+
+// Splits buf into its non-empty lines in place.
+static char **split_lines(char *buf, size_t size, int *count) {
+    int cap = 64, n = 0;
+    char **lines = arena_alloc(&line_arena, cap * sizeof(char *));
+    char *p = buf, *end = buf + size;
+    while (lines && p < end) {
+        char *nl = memchr(p, '\n', end - p);
+        char *stop = nl ? nl : end;
+        *stop = '\0';
+        if (stop > p) {
+            if (n == cap) {
+                lines = arena_realloc(&line_arena, lines, cap * sizeof(char *),
+                                      cap * 2 * sizeof(char *));
+                cap *= 2;
+                if (!lines) break;
+            }
+            lines[n++] = p;
+        }
+        p = stop + 1;
+    }
+    *count = n;
+    return lines;
+}
+
+// Packs the input items into CMD invocations that each fit under ARG_MAX.
+static Task *batch_arguments(const ParallelOptions *opts, char **items, int nitems, int *ntasks) {
+    Task *tasks = arena_alloc(&line_arena, (nitems ? nitems : 1) * sizeof(Task));
+    if (!tasks) return NULL;
+
+    long room = exec_arg_room();
+    if (room >= 0) room = room > ARG_HEADROOM ? room - ARG_HEADROOM : 0;
+    size_t base = sizeof(char *); // The terminating NULL
+    for (int i = 0; i < opts->cmd_argc; i++) base += strlen(opts->cmd[i]) + 1 + sizeof(char *);
+
+    int n = 0, next = 0;
+    do {
+        size_t used = base;
+        int count = 0;
+        while (next + count < nitems) {
+            if (opts->max_args && count == opts->max_args) break;
+            size_t cost = strlen(items[next + count]) + 1 + sizeof(char *);
+            // A batch always takes at least one item; an item too long on
+            // its own is left for spawn_external to report.
+            if (count > 0 && room >= 0 && used + cost > (size_t)room) break;
+            used += cost;
+            count++;
+        }
+
+        Task *t = &tasks[n++];
+        memset(t, 0, sizeof(Task));
+        t->argc = opts->cmd_argc + count;
+        t->argv = arena_alloc(&line_arena, (t->argc + 1) * sizeof(char *));
+        if (!t->argv) return NULL;
+        memcpy(t->argv, opts->cmd, opts->cmd_argc * sizeof(char *));
+        memcpy(t->argv + opts->cmd_argc, items + next, count * sizeof(char *));
+        t->argv[t->argc] = NULL;
+        t->label = count ? items[next] : opts->cmd[0];
+        next += count;
+    } while (next < nitems);
+
+    *ntasks = n;
+    return tasks;
+}
+
+static int run_task_line(void *arg) {
+    // This child is a copy of the shell; its commands stay in its group.
+    set_job_control(0);
+    CommandLine *cmdline = parse_command(arg);
+    if (!cmdline) {
+        printf("Invalid Syntax!\n");
+        return 2;
+    }
+    return handle_execution_flow(cmdline);
+}
+
+// Starts a task in process group pgid, or in a new foreground group if 0.
+// Unless keep_order is set, a task with no file to capture its output in
+// writes straight to stdout; with it, that would break the order.
+static int start_task(Task *t, int in_fd, pid_t pgid, int keep_order) {
+    t->started = 1;
+    t->output = tmpfile();
+    if (!t->output && keep_order) {
+        perror("parallel: tmpfile");
+        return -1;
+    }
+    int out_fd = t->output ? fileno(t->output) : -1;
+
+    if (t->line) {
+        LaunchSpec spec = { NULL, 0, in_fd, out_fd, pgid, pgid == 0 };
+        t->pid = fork_process(&spec, run_task_line, t->line);
+    } else {
+        SimpleCommand cmd = { t->argv, t->argc, NULL, 0 };
+        t->pid = launch_pipeline_stage(&cmd, in_fd, out_fd, pgid, pgid == 0);
+    }
+    return t->pid > 0 ? 0 : -1;
+}
+
+// Sends sig to the running tasks, then SIGCONT so stopped ones act on it.
+static void signal_tasks(const Task *tasks, const int *running, int nrunning,
+                         pid_t group, int sig) {
+    if (group > 0) {
+        kill(-group, sig);
+        kill(-group, SIGCONT);
+        return;
+    }
+    // Without job control the tasks are in the shell's own group.
+    for (int s = 0; s < nrunning; s++) {
+        kill(tasks[running[s]].pid, sig);
+        kill(tasks[running[s]].pid, SIGCONT);
+    }
+}
+
+static int task_failed(const Task *t) {
+    return t->pid <= 0 || !WIFEXITED(t->status) || WEXITSTATUS(t->status) != 0;
+}
+
+// Copies the task's captured output to stdout and reports a failure.
+static void print_task(Task *t, int index) {
+    fflush(stdout);
+    if (t->output) {
+        int fd = fileno(t->output);
+        lseek(fd, 0, SEEK_SET);
+        copy_fd(fd, STDOUT_FILENO, NULL);
+        fclose(t->output);
+        t->output = NULL;
+    }
+    if (t->pid <= 0) {
+        printf("parallel: task %d (%s) could not be started\n", index + 1, t->label);
+    } else if (task_failed(t)) {
+        printf("parallel: task %d (%s) exited with status %d\n", index + 1, t->label,
+               exit_status(t->status));
+    }
+}
+
+int parallel_command(int argc, char **argv) {
+    ParallelOptions opts;
+    if (parse_options(argc, argv, &opts) < 0) return 1;
+
+    if (opts.cmd && !is_builtin(opts.cmd[0]) && !lookup_command_path(opts.cmd[0])) {
+        printf("Command not found!\n");
+        return 1;
+    }
+
+    int in_fd = STDIN_FILENO;
+    if (opts.arg_file) {
+        in_fd = open_input_file(opts.arg_file);
+        if (in_fd < 0) return 1;
+    }
+    size_t size = 0;
+    g_sigint_pending = 0; // Ctrl+C ends reading a terminal's input
+    char *input = read_whole_fd(in_fd, &size, &g_sigint_pending);
+    if (opts.arg_file) close(in_fd);
+    if (!input) {
+        if (errno != EINTR) perror("parallel: read");
+        return 1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int nitems = 0, ntasks = 0;
+    char **items = split_lines(input, size, &nitems);
+    Task *tasks = NULL;
+    if (items && opts.cmd) {
+        tasks = batch_arguments(&opts, items, nitems, &ntasks);
+    } else if (items) {
+        tasks = arena_alloc(&line_arena, (nitems ? nitems : 1) * sizeof(Task));
+        for (int i = 0; tasks && i < nitems; i++) {
+            memset(&tasks[i], 0, sizeof(Task));
+            tasks[i].line = items[i];
+            tasks[i].label = items[i];
+        }
+        ntasks = nitems;
+    }
+    if (!tasks) {
+        free(input);
+        return 1;
+    }
+
+    // The input was consumed here, so tasks read from /dev/null rather
+    // than competing for the rest of it.
+    int task_in = opts.arg_file ? -1 : open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    int slots = opts.jobs < ntasks ? opts.jobs : ntasks;
+    int *running = arena_alloc(&line_arena, (slots ? slots : 1) * sizeof(int));
+    int nrunning = 0, next = 0, printed = 0, failed = 0, stop = 0, stops = 0;
+    pid_t group = 0; // Process group of the running tasks, 0 if none yet
+
+    while (running && (nrunning > 0 || (!stop && next < ntasks))) {
+        while (opts.keep_order && printed < ntasks && tasks[printed].done) {
+            print_task(&tasks[printed], printed);
+            printed++;
+        }
+        while (!stop && nrunning < slots && next < ntasks &&
+               (!opts.keep_order || next - printed < MAX_HELD_OUTPUTS)) {
+            Task *t = &tasks[next];
+            if (start_task(t, task_in, group, opts.keep_order) == 0) {
+                running[nrunning++] = next;
+                if (group == 0 && job_control_enabled()) {
+                    group = t->pid;
+                    g_foreground_pgid = group;
+                    tcsetpgrp(STDIN_FILENO, group);
+                }
+            } else {
+                t->done = 1;
+                if (!opts.keep_order) print_task(t, next);
+            }
+            next++;
+        }
+        if (nrunning == 0) continue;
+
+        int status;
+        pid_t pid = wait_any_child(&status);
+        if (pid < 0) break;
+        for (int s = 0; s < nrunning; s++) {
+            Task *t = &tasks[running[s]];
+            if (t->pid != pid) continue;
+            if (WIFSTOPPED(status)) {
+                if (stops++ == 0) printf("parallel: stopped, ending the running tasks\n");
+                stop = 1;
+                signal_tasks(tasks, running, nrunning, group, stops == 1 ? SIGTERM : SIGKILL);
+                break;
+            }
+            t->status = status;
+            t->done = 1;
+            if (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT) stop = 1;
+            if (!opts.keep_order) print_task(t, running[s]);
+            running[s] = running[--nrunning];
+            break;
+        }
+        // Once the group is empty it may vanish; the next task starts a new one.
+        if (nrunning == 0) group = 0;
+    }
+
+    for (int i = 0; i < ntasks; i++) {
+        if (!tasks[i].started) continue;
+        if (opts.keep_order && i >= printed) print_task(&tasks[i], i);
+        if (tasks[i].output) fclose(tasks[i].output); // Still running when waiting failed
+        if (task_failed(&tasks[i])) failed++;
+    }
+    if (task_in >= 0) close(task_in);
+    free(input);
+    if (job_control_enabled()) tcsetpgrp(STDIN_FILENO, getpgrp());
+    g_foreground_pgid = 0;
+
+    printf("parallel: %d task%s in %.3fs, %d failed", ntasks, ntasks == 1 ? "" : "s",
+           elapsed_since(&start), failed);
+    if (next < ntasks) printf(", %d not started", ntasks - next);
+    printf("\n");
+    return failed || next < ntasks ? 1 : 0;
+}
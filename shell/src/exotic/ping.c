@@ -1,5 +1,6 @@
 #define _POSIX_C_SOURCE 200809L
 #include "exotic/ping.h"
+#include "jobs/jobs.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
@@ -49,7 +50,7 @@ int ping_command(int argc, char **argv) {
     int signal_number = (int)sig_num_long;
     int actual_signal = signal_number % 32;
 
-    if (kill(pid, actual_signal) == 0) {
+    if (signal_pid(pid, actual_signal) == 0) {
         printf("Sent signal %d to process with pid %d\n", signal_number, pid);
     } else {
         if (errno == ESRCH) {
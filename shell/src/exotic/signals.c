@@ -1,23 +1,38 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include "exotic/signals.h"
 #include "jobs/jobs.h"
 #include <signal.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/signalfd.h>
+
+/*
+Ctrl+C and Ctrl+Z reach the shell two ways. While it waits for input they
+are blocked and read from a signalfd by the event loop, which lets the line
+editor discard the line and redraw the prompt in normal code. While a
+command runs they are unblocked and go to the handlers below, which only
+set a flag, pass the signal on to the foreground job and write a newline,
+all of it async-signal-safe.
+*/
 
 // Global variable to track the foreground process group.
 // 'volatile' is important because it's accessed by signal handlers.
 volatile pid_t g_foreground_pgid = 0;
+// Set by Ctrl+C; long-running builtins check it and clear it when they start.
+volatile sig_atomic_t g_sigint_pending = 0;
+
+static int signal_fd = -1;
 
 // Handler for SIGINT (Ctrl+C)
 void handle_sigint(int sig) {
     (void)sig;
+    g_sigint_pending = 1;
     if (g_foreground_pgid > 0) {
         // There is a foreground process, send the signal to its entire group.
         kill(-g_foreground_pgid, SIGINT);
     }
-    // Print a newline to make the prompt appear cleanly, but the shell itself doesn't exit.
-    printf("\n");
+    // A newline, so the next prompt starts cleanly after the echoed ^C.
+    if (write(STDOUT_FILENO, "\n", 1) < 0) {}
 }
 
 // Handler for SIGTSTP (Ctrl+Z)
@@ -25,12 +40,17 @@ void handle_sigtstp(int sig) {
     (void)sig;
     if (g_foreground_pgid > 0) {
         kill(-g_foreground_pgid, SIGTSTP);
-    } else {
-        // No foreground job, so just print a newline for a clean prompt
-        printf("\n");
+    } else if (write(STDOUT_FILENO, "\n", 1) < 0) {
+        // No foreground job; the newline is only for a clean prompt
     }
 }
 
+static void prompt_signals(sigset_t *set) {
+    sigemptyset(set);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGTSTP);
+}
+
 void init_signal_handlers(void) {
     struct sigaction sa_int = {0};
     sa_int.sa_handler = handle_sigint;
@@ -40,8 +60,37 @@ void init_signal_handlers(void) {
     sa_tstp.sa_handler = handle_sigtstp;
     sigaction(SIGTSTP, &sa_tstp, NULL);
 
+    sigset_t set;
+    prompt_signals(&set);
+    signal_fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) perror("signalfd");
+
     // Ignore signals that are meant for interactive shells.
     // This prevents the shell from being stopped or interrupted by terminal control signals.
     signal(SIGTTIN, SIG_IGN);
     signal(SIGTTOU, SIG_IGN);
-}
\ No newline at end of file
+}
+
+int signals_fd(void) {
+    return signal_fd;
+}
+
+int read_signal(void) {
+    struct signalfd_siginfo info;
+    if (signal_fd < 0 || read(signal_fd, &info, sizeof(info)) != sizeof(info)) return 0;
+    if (info.ssi_signo == SIGINT) g_sigint_pending = 1;
+    return info.ssi_signo;
+}
+
+void signals_to_fd(int enabled) {
+    if (signal_fd < 0) return;
+    sigset_t set;
+    prompt_signals(&set);
+    if (enabled) {
+        sigprocmask(SIG_BLOCK, &set, NULL);
+        return;
+    }
+    // Whatever came in at the prompt was meant for it, not for the command.
+    while (read_signal()) {}
+    sigprocmask(SIG_UNBLOCK, &set, NULL);
+}
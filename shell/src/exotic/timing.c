@@ -0,0 +1,193 @@
+#define _POSIX_C_SOURCE 200809L
+#include "exotic/timing.h"
+#include "exotic/signals.h"
+#include "jobs/execution.h"
+#include "jobs/jobs.h"
+#include "cmd_exec.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/*
+"time" and "bench" prefix a whole pipeline rather than being builtins of
+their own, so "time a | b" covers every stage and builtins need no fork.
+What follows the prefix goes through run_pipeline exactly as it would
+untimed, so the figures include the shell's own work of starting and
+waiting for the stages.
+
+time adds two sources: the shell's own usage from getrusage (builtins run
+in-process, plus the cost of spawning) and each stage's from wait4, which
+the job layer sums into a sink while the pipeline runs.
+*/
+
+static int usage(const char *name) {
+    if (strcmp(name, "bench") == 0) {
+        printf("bench: usage: bench -n N [-w W] command\n");
+    } else {
+        printf("time: usage: time command\n");
+    }
+    return 2;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double seconds(struct timeval tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int has_timing_prefix(const Pipeline *pipeline) {
+    if (pipeline->is_background || pipeline->cmds[0].argc == 0) return 0;
+    const char *word = pipeline->cmds[0].argv[0];
+    return strcmp(word, "time") == 0 || strcmp(word, "bench") == 0;
+}
+
+// The pipeline without the first skip words of its first command.
+static const Pipeline *strip_words(const Pipeline *pipeline, int skip) {
+    Pipeline *inner = arena_alloc(&line_arena, sizeof(Pipeline));
+    SimpleCommand *cmds = arena_alloc(&line_arena, pipeline->ncmds * sizeof(SimpleCommand));
+    if (!inner || !cmds) return NULL;
+    *inner = *pipeline;
+    memcpy(cmds, pipeline->cmds, pipeline->ncmds * sizeof(SimpleCommand));
+    cmds[0].argv += skip;
+    cmds[0].argc -= skip;
+    inner->cmds = cmds;
+    return inner;
+}
+
+static int time_pipeline(const Pipeline *pipeline) {
+    struct rusage children = {0};
+    struct rusage before, after;
+    struct rusage *outer = collect_child_usage(&children);
+    getrusage(RUSAGE_SELF, &before);
+    double start = now();
+
+    int status = run_pipeline(pipeline);
+
+    double wall = now() - start;
+    getrusage(RUSAGE_SELF, &after);
+    collect_child_usage(outer);
+
+    // The shell's peak only counts when a builtin ran in it; it is a high
+    // water mark for the whole session, not this command's.
+    long maxrss = children.ru_maxrss;
+    const SimpleCommand *first = &pipeline->cmds[0];
+    if (pipeline->ncmds == 1 && first->argc > 0 && is_builtin(first->argv[0]) &&
+        after.ru_maxrss > maxrss) {
+        maxrss = after.ru_maxrss;
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "real\t%.3fs\n", wall);
+    fprintf(stderr, "user\t%.3fs\n", seconds(after.ru_utime) - seconds(before.ru_utime) +
+                                     seconds(children.ru_utime));
+    fprintf(stderr, "sys\t%.3fs\n", seconds(after.ru_stime) - seconds(before.ru_stime) +
+                                    seconds(children.ru_stime));
+    fprintf(stderr, "maxrss\t%ld KiB\n", maxrss);
+    fprintf(stderr, "ctxsw\t%ld voluntary, %ld involuntary\n",
+            after.ru_nvcsw - before.ru_nvcsw + children.ru_nvcsw,
+            after.ru_nivcsw - before.ru_nivcsw + children.ru_nivcsw);
+    return status;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of n sorted values.
+static double percentile(const double *sorted, int n, double p) {
+    int rank = (int)ceil(p * n);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+static void report_runs(double *times, int n, int warmup) {
+    fflush(stdout);
+    if (n == 0) {
+        fprintf(stderr, "bench: no runs completed\n");
+        return;
+    }
+    qsort(times, n, sizeof(double), compare_doubles);
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += times[i];
+    double mean = sum / n;
+    double var = 0;
+    for (int i = 0; i < n; i++) var += (times[i] - mean) * (times[i] - mean);
+    double stddev = n > 1 ? sqrt(var / (n - 1)) : 0;
+    double median = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+
+    fprintf(stderr, "bench: %d runs, %d warmup\n", n, warmup);
+    fprintf(stderr, "min\t%.3f ms\n", times[0] * 1e3);
+    fprintf(stderr, "median\t%.3f ms\n", median * 1e3);
+    fprintf(stderr, "mean\t%.3f ms\n", mean * 1e3);
+    fprintf(stderr, "p95\t%.3f ms\n", percentile(times, n, 0.95) * 1e3);
+    fprintf(stderr, "p99\t%.3f ms\n", percentile(times, n, 0.99) * 1e3);
+    fprintf(stderr, "stddev\t%.3f ms\n", stddev * 1e3);
+}
+
+static int bench_pipeline(const Pipeline *pipeline, int runs, int warmup) {
+    double *times = malloc(runs * sizeof(double));
+    if (!times) {
+        perror("bench: malloc");
+        return 1;
+    }
+    int status = 0;
+    int done = 0;
+    g_sigint_pending = 0;
+    for (int i = 0; i < warmup + runs; i++) {
+        double start = now();
+        status = run_pipeline(pipeline);
+        double elapsed = now() - start;
+        // Ctrl+C or Ctrl+Z ends the series; the runs so far are reported.
+        if (g_sigint_pending || status == 128 + SIGINT || status == 128 + SIGTSTP) break;
+        if (i >= warmup) times[done++] = elapsed;
+    }
+    report_runs(times, done, warmup);
+    free(times);
+    return status;
+}
+
+static int parse_count(const char *text, long min, long *out) {
+    char *endptr;
+    *out = strtol(text, &endptr, 10);
+    return *endptr == '\0' && endptr != text && *out >= min && *out <= 100000000;
+}
+
+int run_timed(const Pipeline *pipeline) {
+    const SimpleCommand *first = &pipeline->cmds[0];
+    char **argv = first->argv;
+    int is_bench = strcmp(argv[0], "bench") == 0;
+    long runs = -1;
+    long warmup = 0;
+
+    int i = 1;
+    while (is_bench && i < first->argc && argv[i][0] == '-') {
+        if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        }
+        long *value = strcmp(argv[i], "-n") == 0 ? &runs : strcmp(argv[i], "-w") == 0 ? &warmup : NULL;
+        if (!value || i + 1 >= first->argc || !parse_count(argv[i + 1], value == &runs, value)) {
+            return usage(argv[0]);
+        }
+        i += 2;
+    }
+    if (is_bench && (runs < 0 || i == first->argc)) return usage(argv[0]);
+    if (i == first->argc && pipeline->ncmds > 1) {
+        printf("Invalid Syntax!\n");
+        return 2;
+    }
+
+    const Pipeline *inner = strip_words(pipeline, i);
+    if (!inner) return 1;
+    return is_bench ? bench_pipeline(inner, (int)runs, (int)warmup) : time_pipeline(inner);
+}
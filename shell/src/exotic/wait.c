@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+#include "exotic/wait.h"
+#include "exotic/signals.h"
+#include "jobs/jobs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+
+#define WAIT_TIMED_OUT 124 // As timeout(1)
+
+static int usage(void) {
+    printf("wait: usage: wait [-n] [--timeout ms] [%%job ...]\n");
+    return 2;
+}
+
+int wait_command(int argc, char **argv) {
+    int any = 0;
+    long timeout_ms = -1;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-n") == 0) {
+            any = 1;
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            char *endptr;
+            timeout_ms = strtol(argv[++i], &endptr, 10);
+            if (*endptr != '\0' || endptr == argv[i] || timeout_ms < 0 || timeout_ms > INT_MAX) {
+                printf("wait: invalid timeout\n");
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--") == 0) {
+            i++;
+            break;
+        } else {
+            return usage();
+        }
+    }
+
+    // Jobs are named by number, with or without the leading '%'.
+    int n = argc > i ? argc - i : job_count();
+    int *ids = malloc((n > 0 ? n : 1) * sizeof(int));
+    if (!ids) {
+        perror("wait: malloc");
+        return 1;
+    }
+    if (argc > i) {
+        for (int k = 0; k < n; k++) {
+            const char *spec = argv[i + k][0] == '%' ? argv[i + k] + 1 : argv[i + k];
+            char *endptr;
+            long id = strtol(spec, &endptr, 10);
+            if (*endptr != '\0' || endptr == spec || !find_job_by_id((int)id)) {
+                printf("No such job\n");
+                free(ids);
+                return 127;
+            }
+            ids[k] = (int)id;
+        }
+    } else {
+        int k = 0;
+        for (Job *job = first_job(); job; job = job->next) ids[k++] = job->job_id;
+    }
+    if (n == 0) {
+        free(ids);
+        return any ? 127 : 0; // Nothing to wait for
+    }
+
+    g_sigint_pending = 0;
+    int status = 0;
+    int result = wait_for_jobs(ids, n, any, (int)timeout_ms, &g_sigint_pending, &status);
+    free(ids);
+    if (result < 0) return 128 + SIGINT;
+    if (result > 0) return WAIT_TIMED_OUT;
+    return status;
+}
@@ -1,50 +1,35 @@
 #define _POSIX_C_SOURCE 200809L
 #include "jobs/execution.h"
 #include "cmd_exec.h"
+#include "redirect/pipe.h"
+#include "exotic/timing.h"
+#include "trace.h"
+#include "metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include <stdint.h>
 
-void handle_execution_flow(char *line) {
-    if (!line || *line == '\0') return;
-
-    char *line_copy = strdup(line);
-    if (!line_copy) { perror("strdup"); return; }
-    
-    char *current_cmd = line_copy;
-    char *next_sep;
-
-    while (current_cmd && *current_cmd) {
-        next_sep = strpbrk(current_cmd, ";&");
-        int is_background = 0;
+int run_pipeline(const Pipeline *pipeline) {
+    if (has_timing_prefix(pipeline)) return run_timed(pipeline);
+    metric_add(METRIC_COMMANDS, 1);
+    long long span = trace_begin();
+    int status;
+    if (pipeline->ncmds > 1) {
+        status = execute_pipeline(pipeline);
+        trace_end(span, "execute_pipeline", pipeline->text);
+    } else {
+        status = dispatch_command(&pipeline->cmds[0], pipeline->is_background, pipeline->text);
+        trace_end(span, "dispatch_command", pipeline->text);
+    }
+    return status;
+}
 
-        if (next_sep) {
-            if (*next_sep == '&') is_background = 1;
-            *next_sep = '\0';
-        } else {
-            // Check if the whole line ends in '&' without being a separator
-            int len = strlen(current_cmd);
-            if (len > 0 && current_cmd[len-1] == '&') {
-                is_background = 1;
-                current_cmd[len-1] = '\0';
-            }
-        }
-        
-        char *trimmed_cmd = current_cmd;
-        while (isspace((unsigned char)*trimmed_cmd)) trimmed_cmd++;
-        int len = strlen(trimmed_cmd);
-        while (len > 0 && isspace((unsigned char)trimmed_cmd[len - 1])) {
-            trimmed_cmd[--len] = '\0';
-        }
+int handle_execution_flow(const CommandLine *cmdline) {
+    if (!cmdline) return 0;
+    int status = 0;
 
-        if (*trimmed_cmd) {
-            execute_cmd(trimmed_cmd, is_background);
-        }
-        
-        current_cmd = (next_sep) ? next_sep + 1 : NULL;
+    // Pipelines run in source order; one marked background does not wait.
+    for (int i = 0; i < cmdline->npipelines; i++) {
+        status = run_pipeline(&cmdline->pipelines[i]);
     }
-
-    free(line_copy);
-}
\ No newline at end of file
+    return status;
+}
@@ -1,150 +1,715 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include "jobs/jobs.h"
+#include "trace.h"
+#include "metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/signalfd.h>
+#include <sys/pidfd.h>
 #include <signal.h>
 #include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <time.h>
 
-static Job job_list[MAX_JOBS];
+/*
+Children are reaped on demand instead of by polling every job. SIGCHLD is
+blocked and delivered through a signalfd: check_jobs returns at once when it
+has not fired, and otherwise drains waitpid(-1, WNOHANG) a single time,
+mapping each reaped pid to its job through pid_index. The work done is
+proportional to the number of children that changed state, not to the size
+of the job table. Finished jobs are queued as messages for
+print_completed_jobs.
+
+The job table itself has no fixed size. Each job is allocated on its own
+and reachable three ways: by job id, by pgid and by member pid through hash
+indices, and in creation order through a linked list whose tail is the most
+recent job. Command strings are interned, so many jobs started from the
+same line share one copy of any length.
+
+A member is dropped from its job as soon as it is reaped, and a child that
+has not been reaped keeps its pid, so the member pids of a job can never
+name anything else: signals go to them directly. Waits on particular jobs
+(fg, the wait builtin) open pidfds for just those members, at most
+MAX_POLL_PIDFDS at a time, and close them again once woken, so background
+jobs hold no fds however many there are. Members beyond the cap, and stops,
+which do not make a pidfd readable, are noticed through the SIGCHLD
+signalfd instead.
+*/
+
+// Most pidfds a single wait keeps open.
+#define MAX_POLL_PIDFDS 64
+
+typedef struct {
+    int key;    // 0 = empty, -1 = deleted
+    Job *job;
+} MapEntry;
+
+// Open-addressing map from a positive int (pid, pgid or job id) to a job.
+typedef struct {
+    MapEntry *entries;
+    size_t cap;
+    size_t used;  // Including deleted entries
+    size_t live;
+} JobMap;
+
+typedef struct InternedString {
+    struct InternedString *next;
+    unsigned long hash;
+    int refs;
+    char text[];
+} InternedString;
+
+typedef struct CompletedJob {
+    struct CompletedJob *next;
+    char message[];
+} CompletedJob;
+
+static Job *jobs_head = NULL; // Oldest
+static Job *jobs_tail = NULL; // Most recent
+static int jobs_live = 0;
 static int next_job_id = 1;
-static char *completed_jobs_buffer[MAX_JOBS];
-static int completed_count = 0;
 
-void init_jobs() {
-    for (int i = 0; i < MAX_JOBS; i++) {
-        job_list[i].pgid = 0;
-    }
-}
-
-void add_job(pid_t pgid, const char* command, JobStatus initial_status) {
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].pgid == 0) {
-            job_list[i].pgid = pgid;
-            job_list[i].pid = pgid;
-            job_list[i].job_id = next_job_id++;
-            job_list[i].status = initial_status;
-            strncpy(job_list[i].command, command, MAX_CMD_LEN - 1);
-            job_list[i].command[MAX_CMD_LEN - 1] = '\0';
-            if (initial_status == RUNNING) {
-                 printf("[%d] %d\n", job_list[i].job_id, job_list[i].pid);
-            } else if (initial_status == STOPPED) {
-                 printf("\n[%d] Stopped \t%s\n", job_list[i].job_id, job_list[i].command);
-            }
-            return;
+static JobMap id_index;
+static JobMap pgid_index;
+static JobMap pid_index;
+
+static InternedString **intern_buckets = NULL;
+static size_t intern_cap = 0;
+static size_t intern_count = 0;
+
+static CompletedJob *completed_head = NULL;
+static CompletedJob **completed_tail = &completed_head;
+
+static int sigchld_fd = -1;
+static int sigchld_seen = 0; // Drained by a job wait, not yet acted on by check_jobs
+static int job_control = 1;
+static struct rusage *usage_sink = NULL;
+
+/* ---------------- INDICES ---------------- */
+
+static size_t map_slot(const JobMap *map, int key) {
+    return ((size_t)(unsigned)key * 2654435761u) & (map->cap - 1);
+}
+
+static void map_put(JobMap *map, int key, Job *job);
+// Rehashes into a table sized for the live entries, dropping deleted ones.
+static void map_rebuild(JobMap *map) {
+    MapEntry *old = map->entries;
+    size_t old_cap = map->cap;
+
+    size_t new_cap = 64;
+    while (new_cap < (map->live + 1) * 4) new_cap *= 2;
+    map->entries = calloc(new_cap, sizeof(MapEntry));
+    if (!map->entries) {
+        perror("calloc");
+        exit(1);
+    }
+    map->cap = new_cap;
+    map->used = 0;
+    map->live = 0;
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old[i].key > 0) map_put(map, old[i].key, old[i].job);
+    }
+    free(old);
+}
+
+static MapEntry *map_find(const JobMap *map, int key) {
+    if (!map->cap || key <= 0) return NULL;
+    size_t i = map_slot(map, key);
+    while (map->entries[i].key != 0) {
+        if (map->entries[i].key == key) return &map->entries[i];
+        i = (i + 1) & (map->cap - 1);
+    }
+    return NULL;
+}
+
+static void map_put(JobMap *map, int key, Job *job) {
+    MapEntry *existing = map_find(map, key);
+    if (existing) {
+        existing->job = job;
+        return;
+    }
+    if ((map->used + 1) * 4 > map->cap * 3) map_rebuild(map);
+    size_t i = map_slot(map, key);
+    while (map->entries[i].key > 0) i = (i + 1) & (map->cap - 1);
+    if (map->entries[i].key == 0) map->used++;
+    map->live++;
+    map->entries[i].key = key;
+    map->entries[i].job = job;
+}
+
+static Job *map_get(const JobMap *map, int key) {
+    MapEntry *e = map_find(map, key);
+    return e ? e->job : NULL;
+}
+
+static void map_remove(JobMap *map, int key) {
+    MapEntry *e = map_find(map, key);
+    if (e) {
+        e->key = -1;
+        map->live--;
+    }
+}
+
+static void map_free(JobMap *map) {
+    free(map->entries);
+    map->entries = NULL;
+    map->cap = map->used = map->live = 0;
+}
+
+/* ---------------- INTERNED COMMANDS ---------------- */
+
+static unsigned long hash_text(const char *s) {
+    unsigned long h = 5381;
+    while (*s) h = h * 33 + (unsigned char)*s++;
+    return h;
+}
+
+static InternedString *interned_from_text(const char *text) {
+    return (InternedString *)(text - offsetof(InternedString, text));
+}
+
+static void intern_grow(void) {
+    size_t new_cap = intern_cap ? intern_cap * 2 : 64;
+    InternedString **buckets = calloc(new_cap, sizeof(InternedString *));
+    if (!buckets) return; // Keep the old table; chains just get longer.
+    for (size_t i = 0; i < intern_cap; i++) {
+        InternedString *is = intern_buckets[i];
+        while (is) {
+            InternedString *next = is->next;
+            size_t b = is->hash & (new_cap - 1);
+            is->next = buckets[b];
+            buckets[b] = is;
+            is = next;
         }
     }
-    fprintf(stderr, "Shell error: Maximum jobs reached.\n");
+    free(intern_buckets);
+    intern_buckets = buckets;
+    intern_cap = new_cap;
 }
 
-// *** THIS FUNCTION HAS BEEN REWRITTEN FOR THE FIX ***
-void check_jobs() {
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].pgid == 0) {
-            continue; // Skip inactive job slots
+static const char *intern_command(const char *text) {
+    unsigned long h = hash_text(text);
+    if (intern_cap) {
+        for (InternedString *is = intern_buckets[h & (intern_cap - 1)]; is; is = is->next) {
+            if (is->hash == h && strcmp(is->text, text) == 0) {
+                is->refs++;
+                return is->text;
+            }
         }
+    }
+
+    if (intern_count + 1 > intern_cap) intern_grow();
+    if (!intern_cap) return NULL;
+
+    size_t len = strlen(text);
+    InternedString *is = malloc(sizeof(InternedString) + len + 1);
+    if (!is) return NULL;
+    memcpy(is->text, text, len + 1);
+    is->hash = h;
+    is->refs = 1;
+    size_t b = h & (intern_cap - 1);
+    is->next = intern_buckets[b];
+    intern_buckets[b] = is;
+    intern_count++;
+    return is->text;
+}
+
+static void release_command(const char *text) {
+    InternedString *is = interned_from_text(text);
+    if (--is->refs > 0) return;
+
+    InternedString **link = &intern_buckets[is->hash & (intern_cap - 1)];
+    while (*link != is) link = &(*link)->next;
+    *link = is->next;
+    intern_count--;
+    free(is);
+}
+
+/* ---------------- JOB TABLE ---------------- */
+
+void init_jobs() {
+    // Route SIGCHLD through a signalfd. Children get an empty signal mask
+    // from the spawn engine, so blocking it here does not leak into them.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    sigchld_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sigchld_fd < 0) perror("signalfd");
+}
+
+int jobs_signal_fd(void) {
+    return sigchld_fd;
+}
+
+void set_job_control(int enabled) {
+    job_control = enabled;
+}
+
+int job_control_enabled(void) {
+    return job_control;
+}
+
+struct rusage *collect_child_usage(struct rusage *usage) {
+    struct rusage *previous = usage_sink;
+    usage_sink = usage;
+    return previous;
+}
+
+// Adds the usage wait4 returned for a child that has terminated.
+static void collect_usage(int status, const struct rusage *ru) {
+    if (!usage_sink || !(WIFEXITED(status) || WIFSIGNALED(status))) return;
+    timeradd(&usage_sink->ru_utime, &ru->ru_utime, &usage_sink->ru_utime);
+    timeradd(&usage_sink->ru_stime, &ru->ru_stime, &usage_sink->ru_stime);
+    if (ru->ru_maxrss > usage_sink->ru_maxrss) usage_sink->ru_maxrss = ru->ru_maxrss;
+    usage_sink->ru_nvcsw += ru->ru_nvcsw;
+    usage_sink->ru_nivcsw += ru->ru_nivcsw;
+}
+
+int exit_status(int wait_status) {
+    if (WIFEXITED(wait_status)) return WEXITSTATUS(wait_status);
+    if (WIFSIGNALED(wait_status)) return 128 + WTERMSIG(wait_status);
+    if (WIFSTOPPED(wait_status)) return 128 + WSTOPSIG(wait_status);
+    return 1;
+}
+
+Job* first_job(void) {
+    return jobs_head;
+}
+
+int job_count(void) {
+    return jobs_live;
+}
+
+static void free_job(Job *job) {
+    for (int i = 0; i < job->nmembers; i++) {
+        if (job->members[i] > 0) map_remove(&pid_index, job->members[i]);
+    }
+    map_remove(&id_index, job->job_id);
+    map_remove(&pgid_index, job->pgid);
+
+    if (job->prev) job->prev->next = job->next; else jobs_head = job->next;
+    if (job->next) job->next->prev = job->prev; else jobs_tail = job->prev;
+    jobs_live--;
+    metric_set(METRIC_JOBS, jobs_live);
+
+    release_command(job->command);
+    free(job->members);
+    free(job->stage_status);
+    free(job);
+}
+
+// Records that member m was reaped with the given wait status.
+static void forget_member(Job *job, int m, int status) {
+    map_remove(&pid_index, job->members[m]);
+    job->members[m] = 0;
+    job->stage_status[m] = status;
+    job->live_members--;
+}
+
+void add_job(pid_t pgid, const pid_t *pids, const int *statuses, int npids,
+             const char* command, JobStatus initial_status) {
+    Job *job = calloc(1, sizeof(Job));
+    if (!job) {
+        perror("calloc");
+        return;
+    }
+    job->members = malloc(npids * sizeof(pid_t));
+    job->stage_status = calloc(npids, sizeof(int));
+    job->command = intern_command(command);
+    if (!job->members || !job->stage_status || !job->command) {
+        perror("malloc");
+        if (job->command) release_command(job->command);
+        free(job->members);
+        free(job->stage_status);
+        free(job);
+        return;
+    }
+    memcpy(job->members, pids, npids * sizeof(pid_t));
+    if (statuses) memcpy(job->stage_status, statuses, npids * sizeof(int));
+    job->nmembers = npids;
+    for (int m = 0; m < npids; m++) {
+        if (pids[m] > 0) job->live_members++;
+    }
+    job->pgid = pgid;
+    job->pid = pgid;
+    job->job_id = next_job_id++;
+    job->status = initial_status;
 
+    job->prev = jobs_tail;
+    if (jobs_tail) jobs_tail->next = job; else jobs_head = job;
+    jobs_tail = job;
+    jobs_live++;
+    metric_set(METRIC_JOBS, jobs_live);
+
+    map_put(&id_index, job->job_id, job);
+    map_put(&pgid_index, job->pgid, job);
+    for (int m = 0; m < npids; m++) {
+        if (pids[m] > 0) map_put(&pid_index, pids[m], job);
+    }
+
+    if (initial_status == RUNNING) {
+         printf("[%d] %d\n", job->job_id, job->pid);
+    } else if (initial_status == STOPPED) {
+         printf("\n[%d] Stopped \t%s\n", job->job_id, job->command);
+    }
+}
+
+static int wait_stages(pid_t pgid, pid_t *pids, int *statuses, int npids) {
+    int live = 0;
+    for (int i = 0; i < npids; i++) {
+        if (pids[i] > 0) live++;
+    }
+
+    // Waiting on the whole group returns whichever stage changes state
+    // first, so a stage that stops on its own cannot leave us blocked on
+    // another one that is waiting for its input. Without job control the
+    // stages share the shell's group, so they are waited for one by one.
+    int next = 0;
+    while (live > 0) {
         int status;
-        pid_t child_pid;
-
-        // Repeatedly check the job's process group, reaping any children that have
-        // terminated. This handles pipelines where multiple processes finish.
-        while ((child_pid = waitpid(-job_list[i].pgid, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) {
-            if (WIFSTOPPED(status)) {
-                job_list[i].status = STOPPED;
-            } else if (WIFCONTINUED(status)) {
-                job_list[i].status = RUNNING;
-            } else if (WIFEXITED(status) || WIFSIGNALED(status)) {
-                // Process has terminated
-                char buffer[MAX_CMD_LEN + 50];
-                if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
-                    snprintf(buffer, sizeof(buffer), "%s with pid %d exited normally", job_list[i].command, job_list[i].pid);
-                } else {
-                    snprintf(buffer, sizeof(buffer), "%s with pid %d exited abnormally", job_list[i].command, job_list[i].pid);
-                }
-                if (completed_count < MAX_JOBS) {
-                    completed_jobs_buffer[completed_count++] = strdup(buffer);
-                }
-                job_list[i].pgid = 0; // Mark the slot as free.
-                break; // Exit the while loop since this job is done
+        struct rusage ru;
+        pid_t target = -pgid;
+        if (!job_control) {
+            while (pids[next] <= 0) next++;
+            target = pids[next];
+        }
+        pid_t pid = wait4(target, &status, WUNTRACED, &ru);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break; // ECHILD: the remaining stages were reaped elsewhere.
+        }
+        collect_usage(status, &ru);
+        for (int i = 0; i < npids; i++) {
+            if (pids[i] != pid) continue;
+            if (WIFSTOPPED(status)) return 1;
+            pids[i] = 0;
+            statuses[i] = status;
+            live--;
+        }
+    }
+    return 0;
+}
+
+int wait_for_stages(pid_t pgid, pid_t *pids, int *statuses, int npids) {
+    long long span = trace_begin();
+    int stopped = wait_stages(pgid, pids, statuses, npids);
+    trace_end(span, "wait_for_stages", NULL);
+    return stopped;
+}
+
+// Returns 1 if SIGCHLD arrived since the last call, consuming the notifications.
+static int sigchld_pending(void) {
+    if (sigchld_fd < 0) return 1; // No signalfd: fall back to always draining.
+
+    struct signalfd_siginfo info[16];
+    int pending = sigchld_seen;
+    sigchld_seen = 0;
+    while (read(sigchld_fd, info, sizeof(info)) > 0) {
+        pending = 1;
+    }
+    return pending;
+}
+
+// Sleeps until a member of one of the jobs exits or timeout_ms passes (-1:
+// no limit). With any_child set, or for members it has no pidfd for, a
+// state change of any child wakes it too. Returns poll's result.
+static int poll_jobs(Job *const *jobs, int njobs, int any_child, int timeout_ms) {
+    struct pollfd fds[MAX_POLL_PIDFDS + 1];
+    int nfds = 0;
+    for (int j = 0; j < njobs; j++) {
+        for (int m = 0; m < jobs[j]->nmembers; m++) {
+            if (jobs[j]->members[m] <= 0) continue;
+            // Past the cap, or without a pidfd (no kernel support, out of
+            // fds), the member is still noticed through SIGCHLD.
+            int fd = nfds < MAX_POLL_PIDFDS ? pidfd_open(jobs[j]->members[m], 0) : -1;
+            if (fd < 0) {
+                any_child = 1;
+                continue;
             }
+            fds[nfds].fd = fd;
+            fds[nfds].events = POLLIN;
+            nfds++;
         }
+    }
+    int npidfds = nfds;
+    if (any_child && sigchld_fd >= 0) {
+        fds[nfds].fd = sigchld_fd;
+        fds[nfds].events = POLLIN;
+        nfds++;
+    } else if (any_child && (timeout_ms < 0 || timeout_ms > 10)) {
+        timeout_ms = 10; // Nothing to wake us up: look again shortly.
+    }
+
+    int ready = poll(fds, nfds, timeout_ms);
+    // The notification is consumed here, so check_jobs is told separately.
+    if (ready > 0 && any_child && sigchld_fd >= 0 && fds[nfds - 1].revents) {
+        sigchld_seen = sigchld_pending();
+    }
+    int saved = errno;
+    for (int i = 0; i < npidfds; i++) close(fds[i].fd);
+    errno = saved;
+    return ready;
+}
 
-        // After the loop, if waitpid failed with ECHILD, it means all processes
-        // in the group have been reaped and the job is truly done.
-        if (child_pid < 0 && errno == ECHILD && job_list[i].pgid != 0) {
-            // The job is done but we didn't catch the exit status above
-            char buffer[MAX_CMD_LEN + 50];
-            snprintf(buffer, sizeof(buffer), "%s with pid %d exited normally", job_list[i].command, job_list[i].pid);
-            if (completed_count < MAX_JOBS) {
-                completed_jobs_buffer[completed_count++] = strdup(buffer);
+// Collects the state changes of the job's own members without reaping any
+// other child. Returns 1 if a member stopped.
+static int reap_members(Job *job) {
+    int stopped = 0;
+    for (int m = 0; m < job->nmembers; m++) {
+        while (job->members[m] > 0) {
+            int status = 0;
+            struct rusage ru;
+            pid_t pid = wait4(job->members[m], &status, WNOHANG | WUNTRACED | WCONTINUED, &ru);
+            if (pid == 0) break;
+            if (pid < 0 && errno == EINTR) continue;
+            if (pid > 0) collect_usage(status, &ru);
+            if (pid > 0 && WIFSTOPPED(status)) {
+                job->status = STOPPED;
+                stopped = 1;
+                break;
+            }
+            if (pid > 0 && WIFCONTINUED(status)) {
+                job->status = RUNNING;
+                continue;
             }
-            job_list[i].pgid = 0; // Mark the slot as free.
+            // Exited, or ECHILD: it was reaped elsewhere.
+            forget_member(job, m, status);
         }
     }
+    return stopped;
 }
 
-void print_completed_jobs() {
-    for (int i = 0; i < completed_count; i++) {
-        printf("%s\n", completed_jobs_buffer[i]);
-        free(completed_jobs_buffer[i]);
+int wait_for_job(Job *job) {
+    long long span = trace_begin();
+    job->status = RUNNING;
+    int stopped;
+    int failed = 0;
+    while (!(stopped = reap_members(job)) && job->live_members > 0) {
+        if (poll_jobs(&job, 1, 1, -1) < 0 && errno != EINTR) {
+            perror("poll");
+            failed = 1;
+            break;
+        }
+    }
+    trace_end(span, "wait_for_job", job->command);
+    if (failed) return 0; // Left running in the background
+    if (!stopped || job->live_members == 0) {
+        free_job(job);
+        return 0;
     }
-    completed_count = 0;
+    return 1;
 }
 
-void kill_all_jobs() {
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].pgid != 0) {
-            kill(-job_list[i].pgid, SIGKILL);
+static void queue_completion(const Job *job) {
+    // Like a POSIX shell, a pipeline's status is that of its last stage.
+    int last = job->stage_status[job->nmembers - 1];
+    int abnormal = !(WIFEXITED(last) && WEXITSTATUS(last) == 0);
+    int len = snprintf(NULL, 0, "%s with pid %d exited %s", job->command, job->pid,
+                       abnormal ? "abnormally" : "normally");
+    CompletedJob *done = malloc(sizeof(CompletedJob) + len + 1);
+    if (!done) {
+        perror("malloc");
+        return;
+    }
+    snprintf(done->message, len + 1, "%s with pid %d exited %s", job->command, job->pid,
+             abnormal ? "abnormally" : "normally");
+    done->next = NULL;
+    *completed_tail = done;
+    completed_tail = &done->next;
+}
+
+// Applies a state change reported by waitpid to the job owning child_pid.
+// Returns 0 if the child is not part of any job.
+static int update_job_member(pid_t child_pid, int status) {
+    Job *job = map_get(&pid_index, child_pid);
+    if (!job) return 0;
+
+    if (WIFSTOPPED(status)) {
+        job->status = STOPPED;
+    } else if (WIFCONTINUED(status)) {
+        job->status = RUNNING;
+    } else if (WIFEXITED(status) || WIFSIGNALED(status)) {
+        // Process has terminated
+        for (int m = 0; m < job->nmembers; m++) {
+            if (job->members[m] == child_pid) forget_member(job, m, status);
+        }
+        if (job->live_members == 0) {
+            queue_completion(job);
+            free_job(job);
+        }
+    }
+    return 1;
+}
+
+void check_jobs() {
+    if (!sigchld_pending()) return;
+
+    long long span = trace_begin();
+    int status;
+    pid_t child_pid;
+    while ((child_pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) {
+        // Children outside any job (e.g. a finished foreground stage) are just reaped.
+        update_job_member(child_pid, status);
+    }
+    trace_end(span, "check_jobs", NULL);
+}
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+int wait_for_jobs(const int *ids, int n, int any, int timeout_ms,
+                  volatile sig_atomic_t *stop, int *status) {
+    Job **live = malloc((n > 0 ? n : 1) * sizeof(Job *));
+    if (!live) {
+        perror("malloc");
+        return -1;
+    }
+    long deadline = timeout_ms >= 0 ? now_ms() + timeout_ms : -1;
+    int result = 0;
+    *status = 0;
+    while (1) {
+        int nlive = 0;
+        int done = 0;
+        for (int i = 0; i < n && !done; i++) {
+            Job *job = map_get(&id_index, ids[i]);
+            if (!job) continue; // Finished on an earlier pass
+            reap_members(job);
+            if (job->live_members > 0) {
+                live[nlive++] = job;
+                continue;
+            }
+            if (any || i == n - 1) *status = exit_status(job->stage_status[job->nmembers - 1]);
+            done = any;
+            queue_completion(job);
+            free_job(job);
+        }
+        if (done || nlive == 0) break;
+
+        if (*stop) {
+            result = -1;
+            break;
+        }
+        int wait_ms = -1;
+        if (deadline >= 0) {
+            wait_ms = deadline - now_ms();
+            if (wait_ms <= 0) {
+                result = 1;
+                break;
+            }
+        }
+        if (poll_jobs(live, nlive, 0, wait_ms) < 0) {
+            if (errno != EINTR) perror("poll");
+            if (errno != EINTR || *stop) {
+                result = -1;
+                break;
+            }
         }
     }
+    free(live);
+    return result;
+}
+
+int signal_job(Job *job, int sig) {
+    int sent = 0;
+    int pinned = 0;
+    errno = ESRCH;
+    for (int m = 0; m < job->nmembers; m++) {
+        if (job->members[m] <= 0) continue;
+        pinned = 1;
+        // Safe without a pidfd: the member is not reaped, so it keeps its pid.
+        if (kill(job->members[m], sig) == 0) sent = 1;
+    }
+    // Processes the stages started themselves are only reachable through
+    // the group. Its id cannot have been reused while one of our members is
+    // unreaped; a member that receives the signal twice is harmless for the
+    // ones job control sends (SIGCONT, SIGKILL).
+    if (pinned && job_control && kill(-job->pgid, sig) == 0) sent = 1;
+    return sent ? 0 : -1;
+}
+
+int signal_pid(pid_t pid, int sig) {
+    // A job member is still unreaped, as in signal_job.
+    if (map_get(&pid_index, pid)) return kill(pid, sig);
+    // Not ours: pin the process before signalling it.
+    int fd = pidfd_open(pid, 0);
+    if (fd < 0) return errno == ENOSYS ? kill(pid, sig) : -1;
+    int result = pidfd_send_signal(fd, sig, NULL, 0);
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return result;
 }
 
-int get_job_list(Job job_snapshot[MAX_JOBS]) {
-    int count = 0;
-    for (int i = 0; i < MAX_JOBS && count < MAX_JOBS; i++) {
-        if (job_list[i].pgid != 0) {
-            memcpy(&job_snapshot[count], &job_list[i], sizeof(Job));
-            count++;
+pid_t wait_any_child(int *status) {
+    while (1) {
+        struct rusage ru;
+        pid_t child_pid = wait4(-1, status, WUNTRACED | WCONTINUED, &ru);
+        if (child_pid < 0) {
+            if (errno == EINTR) continue;
+            return -1;
         }
+        if (update_job_member(child_pid, *status)) continue;
+        collect_usage(*status, &ru);
+        if (WIFEXITED(*status) || WIFSIGNALED(*status) || WIFSTOPPED(*status)) {
+            return child_pid;
+        }
+    }
+}
+
+void print_completed_jobs() {
+    while (completed_head) {
+        CompletedJob *done = completed_head;
+        completed_head = done->next;
+        printf("%s\n", done->message);
+        free(done);
+    }
+    completed_tail = &completed_head;
+}
+
+int has_completed_jobs(void) {
+    return completed_head != NULL;
+}
+
+void kill_all_jobs() {
+    for (Job *job = jobs_head; job; job = job->next) {
+        signal_job(job, SIGKILL);
     }
-    return count;
 }
 
 void cleanup_jobs() {
     check_jobs();
     print_completed_jobs();
+    while (jobs_head) free_job(jobs_head);
+    map_free(&id_index);
+    map_free(&pgid_index);
+    map_free(&pid_index);
+    free(intern_buckets);
+    intern_buckets = NULL;
+    intern_cap = 0;
 }
 
 Job* find_job_by_id(int job_id) {
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].pgid != 0 && job_list[i].job_id == job_id) {
-            return &job_list[i];
-        }
-    }
-    return NULL;
+    return map_get(&id_index, job_id);
 }
 
 Job* find_most_recent_job(void) {
-    int max_job_id = -1;
-    Job* most_recent_job = NULL;
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].pgid != 0 && job_list[i].job_id > max_job_id) {
-            max_job_id = job_list[i].job_id;
-            most_recent_job = &job_list[i];
-        }
-    }
-    return most_recent_job;
+    return jobs_tail;
 }
 
 int remove_job_by_pgid(pid_t pgid) {
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].pgid == pgid) {
-            job_list[i].pgid = 0;
-            return 1;
-        }
-    }
-    return 0;
-}
\ No newline at end of file
+    Job *job = map_get(&pgid_index, pgid);
+    if (!job) return 0;
+    free_job(job);
+    return 1;
+}
@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+#include "jobs/spawn.h"
+#include "jobs/jobs.h"
+#include "redirect/input_redirect.h"
+#include "redirect/output_redirect.h"
+#include "trace.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+
+// glibc 2.35 can hand the terminal over from inside the spawned child, which
+// closes the window where a fast foreground child reads the tty before the
+// parent has called tcsetpgrp() and gets stopped by SIGTTIN.
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35))
+#define HAVE_SPAWN_TCSETPGRP 1
+#endif
+
+extern char **environ;
+
+// The fds a child ends up with. Redirection files take priority over pipe
+// ends, so '>' on a middle pipeline stage starves the next stage as before.
+typedef struct {
+    int in;
+    int out;
+    int file_in;
+    int file_out;
+} ChildFds;
+
+typedef struct {
+    const char *path;
+    char **argv;
+} ExecArgs;
+
+static void release_fds(const ChildFds *fds);
+
+// Opens every redirection in order, like a POSIX shell: all of them must
+// succeed, and a later one replaces an earlier one on the same stream.
+static int prepare_fds(const LaunchSpec *spec, ChildFds *fds) {
+    fds->file_in = fds->file_out = -1;
+
+    long long span = spec->nredirs ? trace_begin() : 0;
+    for (int i = 0; i < spec->nredirs; i++) {
+        const Redirection *r = &spec->redirs[i];
+        int fd;
+        if (r->type == REDIR_INPUT) {
+            fd = open_input_file(r->target);
+        } else {
+            fd = open_output_file(r->target, r->type == REDIR_APPEND);
+        }
+        if (fd < 0) {
+            release_fds(fds);
+            trace_end(span, "redirect", r->target);
+            return -1;
+        }
+        int *slot = r->type == REDIR_INPUT ? &fds->file_in : &fds->file_out;
+        if (*slot >= 0) close(*slot);
+        *slot = fd;
+    }
+
+    trace_end(span, "redirect", spec->nredirs ? spec->redirs[0].target : NULL);
+    fds->in = fds->file_in >= 0 ? fds->file_in : spec->in_fd;
+    fds->out = fds->file_out >= 0 ? fds->file_out : spec->out_fd;
+    return 0;
+}
+
+static void release_fds(const ChildFds *fds) {
+    if (fds->file_in >= 0) close(fds->file_in);
+    if (fds->file_out >= 0) close(fds->file_out);
+}
+
+// Signals the shell handles or may have inherited as ignored, which children
+// must get back as default.
+static void child_default_signals(sigset_t *set) {
+    sigemptyset(set);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGQUIT);
+    sigaddset(set, SIGTSTP);
+    sigaddset(set, SIGTTIN);
+    sigaddset(set, SIGTTOU);
+    sigaddset(set, SIGCHLD);
+    sigaddset(set, SIGPIPE);
+}
+
+static pid_t fork_with_fds(const LaunchSpec *spec, const ChildFds *fds,
+                           int (*body)(void *), void *arg) {
+    fflush(stdout); // The child flushes its copy of the buffer on exit.
+    pid_t pid = fork();
+    if (pid == 0) { // Child process
+        if (job_control_enabled() && spec->pgid >= 0) {
+            setpgid(0, spec->pgid);
+            if (spec->foreground && isatty(STDIN_FILENO)) tcsetpgrp(STDIN_FILENO, getpgrp());
+        }
+
+        sigset_t defaults;
+        child_default_signals(&defaults);
+        for (int sig = 1; sig < NSIG; sig++) {
+            if (sigismember(&defaults, sig) == 1) signal(sig, SIG_DFL);
+        }
+        sigset_t empty;
+        sigemptyset(&empty);
+        sigprocmask(SIG_SETMASK, &empty, NULL);
+
+        if (fds->in >= 0 && fds->in != STDIN_FILENO) {
+            dup2(fds->in, STDIN_FILENO);
+            close(fds->in);
+        }
+        if (fds->out >= 0 && fds->out != STDOUT_FILENO) {
+            dup2(fds->out, STDOUT_FILENO);
+            close(fds->out);
+        }
+
+        int status = body(arg);
+        fflush(stdout);
+        _exit(status);
+    } else if (pid > 0) { // Parent process
+        // Also set the group from the parent so it exists before we return.
+        if (job_control_enabled() && spec->pgid >= 0) setpgid(pid, spec->pgid ? spec->pgid : pid);
+    } else {
+        perror("fork");
+    }
+    return pid;
+}
+
+pid_t fork_process(const LaunchSpec *spec, int (*body)(void *), void *arg) {
+    ChildFds fds;
+    if (prepare_fds(spec, &fds) < 0) return -1;
+    long long span = trace_begin();
+    long long started = metric_now();
+    pid_t pid = fork_with_fds(spec, &fds, body, arg);
+    metric_observe(HISTOGRAM_SPAWN, metric_now() - started);
+    trace_end(span, "fork", NULL);
+    release_fds(&fds);
+    return pid;
+}
+
+// Bytes execve() needs for a list of strings, counted the way the kernel
+// does: every string including its terminator, plus its pointer.
+static size_t strings_size(char **strings) {
+    size_t total = 0;
+    for (char **p = strings; p && *p; p++) total += strlen(*p) + 1 + sizeof(char *);
+    return total;
+}
+
+long exec_arg_room(void) {
+    static long arg_max = 0;
+    if (arg_max == 0) {
+        arg_max = sysconf(_SC_ARG_MAX);
+        if (arg_max <= 0) arg_max = -1; // No known limit
+    }
+    if (arg_max < 0) return -1;
+    long room = arg_max - (long)strings_size(environ);
+    return room > 0 ? room : 0;
+}
+
+// Rejects argument lists the kernel would refuse with E2BIG, before any
+// redirection file is opened or process created.
+static int check_exec_args(char **argv) {
+    long room = exec_arg_room();
+    if (room >= 0 && strings_size(argv) > (size_t)room) {
+        printf("Argument list too long!\n");
+        return -1;
+    }
+    return 0;
+}
+
+// The command execvp() falls back to for a file the kernel cannot execute
+// (ENOEXEC): /bin/sh running it as a script, with the same arguments.
+static char **script_args(const char *path, char **argv) {
+    int argc = 0;
+    while (argv[argc]) argc++;
+    char **sh_argv = malloc((argc + 2) * sizeof(char *));
+    if (!sh_argv) return NULL;
+    sh_argv[0] = "/bin/sh";
+    sh_argv[1] = (char *)path;
+    for (int i = 1; i <= argc; i++) sh_argv[i + 1] = argv[i];
+    return sh_argv;
+}
+
+static int exec_body(void *arg) {
+    ExecArgs *ea = arg;
+    execve(ea->path, ea->argv, environ);
+    if (errno == ENOEXEC) {
+        char **sh_argv = script_args(ea->path, ea->argv);
+        if (sh_argv) execve("/bin/sh", sh_argv, environ);
+    }
+    printf(errno == E2BIG ? "Argument list too long!\n" : "Command not found!\n");
+    return 127;
+}
+
+pid_t spawn_external(const char *path, char **argv, const LaunchSpec *spec) {
+    if (check_exec_args(argv) < 0) return -1;
+
+    ChildFds fds;
+    if (prepare_fds(spec, &fds) < 0) return -1;
+
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_init(&attr);
+    posix_spawn_file_actions_init(&actions);
+
+    sigset_t defaults, empty;
+    child_default_signals(&defaults);
+    sigemptyset(&empty);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    if (job_control_enabled() && spec->pgid >= 0) flags |= POSIX_SPAWN_SETPGROUP;
+    posix_spawnattr_setflags(&attr, flags);
+    posix_spawnattr_setpgroup(&attr, spec->pgid);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setsigmask(&attr, &empty);
+
+    int handoff_in_child = 0;
+    int is_tty = job_control_enabled() && spec->foreground && isatty(STDIN_FILENO);
+#ifdef HAVE_SPAWN_TCSETPGRP
+    // Must run before stdin is replaced by a pipe or file.
+    if (is_tty && posix_spawn_file_actions_addtcsetpgrp_np(&actions, STDIN_FILENO) == 0) {
+        handoff_in_child = 1;
+    }
+#endif
+    if (fds.in >= 0) posix_spawn_file_actions_adddup2(&actions, fds.in, STDIN_FILENO);
+    if (fds.out >= 0) posix_spawn_file_actions_adddup2(&actions, fds.out, STDOUT_FILENO);
+
+    // Anything the shell printed so far must reach the output before the
+    // child's own writes; stdout is fully buffered when it is not a tty.
+    fflush(stdout);
+    pid_t pid = -1;
+    long long span = trace_begin();
+    long long started = metric_now();
+    int err = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+    if (err == ENOEXEC) {
+        char **sh_argv = script_args(path, argv);
+        if (sh_argv) {
+            err = posix_spawn(&pid, "/bin/sh", &actions, &attr, sh_argv, environ);
+            free(sh_argv);
+        }
+    }
+    metric_observe(HISTOGRAM_SPAWN, metric_now() - started);
+    trace_end(span, "posix_spawn", path);
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (err == 0) {
+        if (is_tty && !handoff_in_child) {
+            tcsetpgrp(STDIN_FILENO, spec->pgid ? spec->pgid : pid);
+        }
+    } else if (err == ENOSYS || err == EINVAL || err == ENOTSUP) {
+        // posix_spawn could not honour one of the attributes; fall back to fork.
+        ExecArgs ea = { path, argv };
+        pid = fork_with_fds(spec, &fds, exec_body, &ea);
+    } else {
+        // E2BIG here means a single argument went over the kernel's
+        // per-string limit, which ARG_MAX does not cover.
+        printf(err == E2BIG ? "Argument list too long!\n" : "Command not found!\n");
+        pid = -1;
+    }
+
+    release_fds(&fds);
+    if (pid > 0) metric_add(METRIC_EXTERNALS, 1);
+    return pid;
+}
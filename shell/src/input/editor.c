@@ -0,0 +1,422 @@
+#define _GNU_SOURCE
+#include "input/editor.h"
+#include "input/loop.h"
+#include "input/prompt.h"
+#include "jobs/jobs.h"
+#include "exotic/signals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+/*
+The terminal is put in raw mode (no canonical input, no echo) only while a
+line is being typed, and back in the mode it had at startup before the
+line runs, so commands see an ordinary terminal. Signal keys are left on:
+Ctrl+C and Ctrl+Z arrive as signals on the signalfd from signals.c.
+
+Input is read one byte at a time, as much as FIONREAD reports, and never
+past the end of the line: bytes typed ahead belong to whatever runs next.
+
+The screen is redrawn from the prompt's first row, which is tracked in
+cursor_row. Widths count UTF-8 code points as one column each; lines may
+wrap across rows. A tab is kept in the line but drawn as a single space,
+so that it takes one column too; other control characters, which only
+get in after Ctrl+V, are drawn as '?' for the same reason.
+
+Finished jobs are reported as soon as SIGCHLD arrives: the line is taken
+off the screen, the messages printed, and the prompt and line put back.
+*/
+
+#define KEY_CTRL(c) ((c) & 0x1f)
+#define KEY_BACKSPACE 127
+#define CSI_MAX 16
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t cursor;     // Byte offset, always at the start of a code point
+    int done;
+    int eof;
+    int esc;           // 0, 1 after ESC, 2 inside a CSI sequence
+    int literal;       // After Ctrl+V: the next byte goes in as it is
+    int fresh;         // Nothing read yet, and input was queued in canonical mode
+    char csi[CSI_MAX]; // Parameters of the CSI sequence so far
+    int csi_len;
+    int cursor_row;    // Rows from the prompt's first row to the cursor
+    int active;        // The prompt and line are on screen
+} Editor;
+
+static Editor ed;
+static struct termios saved_tty;
+static int state = 0; // 0 not set up, 1 ready, -1 not a terminal
+
+static char *out = NULL;
+static size_t out_len = 0, out_cap = 0;
+
+/* ---------------- OUTPUT ---------------- */
+
+static void emit(const char *s, size_t n) {
+    if (out_len + n > out_cap) {
+        size_t cap = out_cap ? out_cap : 256;
+        while (cap < out_len + n) cap *= 2;
+        char *bigger = realloc(out, cap);
+        if (!bigger) return;
+        out = bigger;
+        out_cap = cap;
+    }
+    memcpy(out + out_len, s, n);
+    out_len += n;
+}
+
+static int is_control(unsigned char c) {
+    return c < 0x20 || c == 0x7f;
+}
+
+// Emits text from the line, drawing a tab as a space and any other
+// control character as '?'.
+static void emit_text(const char *s, size_t n) {
+    const char *end = s + n;
+    while (s < end) {
+        const char *ctl = s;
+        while (ctl < end && !is_control(*ctl)) ctl++;
+        emit(s, ctl - s);
+        if (ctl < end) emit(*ctl == '\t' ? " " : "?", 1);
+        s = ctl + 1;
+    }
+}
+
+static void emitf(const char *fmt, int n) {
+    char seq[32];
+    int len = snprintf(seq, sizeof(seq), fmt, n);
+    if (len > 0) emit(seq, len);
+}
+
+static void flush_out(void) {
+    for (size_t done = 0; done < out_len;) {
+        ssize_t n = write(STDOUT_FILENO, out + done, out_len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    out_len = 0;
+}
+
+static size_t text_width(const char *s, size_t n) {
+    size_t width = 0;
+    for (size_t i = 0; i < n; i++) {
+        if ((s[i] & 0xC0) != 0x80) width++;
+    }
+    return width;
+}
+
+static size_t term_cols(void) {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) return ws.ws_col;
+    return 80;
+}
+
+// Moves to the prompt's first row and clears from there down.
+static void clear_line(void) {
+    emit("\r", 1);
+    if (ed.cursor_row > 0) emitf("\033[%dA", ed.cursor_row);
+    emit("\033[J", 3);
+    ed.cursor_row = 0;
+}
+
+static void redraw(void) {
+    size_t plen;
+    const char *prompt = current_prompt(&plen);
+    size_t cols = term_cols();
+    size_t pw = text_width(prompt, plen);
+    size_t total = pw + text_width(ed.buf, ed.len);
+    size_t at = pw + text_width(ed.buf, ed.cursor);
+
+    clear_line();
+    emit(prompt, plen);
+    emit_text(ed.buf, ed.len);
+    // At an exact multiple of the width the terminal holds the cursor at
+    // the end of the row; force the wrap so the row counts below hold.
+    if (total % cols == 0) emit("\r\n", 2);
+
+    int end_row = total / cols;
+    int row = at / cols;
+    if (at != total) {
+        if (end_row > row) emitf("\033[%dA", end_row - row);
+        emit("\r", 1);
+        if (at % cols) emitf("\033[%dC", at % cols);
+    }
+    ed.cursor_row = row;
+    flush_out();
+}
+
+/* ---------------- EDITING ---------------- */
+
+static int is_continuation(size_t pos) {
+    return pos < ed.len && (ed.buf[pos] & 0xC0) == 0x80;
+}
+
+static size_t prev_char(size_t pos) {
+    if (pos == 0) return 0;
+    do pos--; while (pos > 0 && is_continuation(pos));
+    return pos;
+}
+
+static size_t next_char(size_t pos) {
+    if (pos >= ed.len) return ed.len;
+    do pos++; while (is_continuation(pos));
+    return pos;
+}
+
+static int is_blank(size_t pos) {
+    return ed.buf[pos] == ' ' || ed.buf[pos] == '\t';
+}
+
+// Start of the word before pos, past any blanks in between.
+static size_t word_start(size_t pos) {
+    while (pos > 0 && is_blank(pos - 1)) pos--;
+    while (pos > 0 && !is_blank(pos - 1)) pos--;
+    return pos;
+}
+
+static void delete_range(size_t from, size_t to) {
+    if (from >= to) return;
+    memmove(ed.buf + from, ed.buf + to, ed.len - to);
+    ed.len -= to - from;
+    ed.cursor = from;
+    redraw();
+}
+
+static void insert_byte(char c) {
+    if (ed.len + 2 > ed.cap) {
+        size_t cap = ed.cap ? ed.cap * 2 : 256;
+        char *bigger = realloc(ed.buf, cap);
+        if (!bigger) {
+            perror("realloc");
+            return;
+        }
+        ed.buf = bigger;
+        ed.cap = cap;
+    }
+    memmove(ed.buf + ed.cursor + 1, ed.buf + ed.cursor, ed.len - ed.cursor);
+    ed.buf[ed.cursor++] = c;
+    ed.len++;
+
+    if (ed.cursor == ed.len) {
+        // Typing at the end of the line: just echo it. At the last column
+        // the terminal holds the cursor on this row until the next byte.
+        size_t plen;
+        const char *prompt = current_prompt(&plen);
+        size_t total = text_width(prompt, plen) + text_width(ed.buf, ed.len);
+        ed.cursor_row = (total - 1) / term_cols();
+        emit_text(&c, 1);
+        flush_out();
+    } else {
+        redraw();
+    }
+}
+
+static void move_to(size_t pos) {
+    ed.cursor = pos;
+    redraw();
+}
+
+// Cursor keys and the like: ESC [ <params> <final>, or ESC O <final>.
+static void handle_escape(unsigned char c) {
+    if (ed.esc == 1) {
+        ed.esc = (c == '[' || c == 'O') ? 2 : 0;
+        ed.csi_len = 0;
+        return;
+    }
+    if (c < 0x40 || c > 0x7e) {
+        if (ed.csi_len < CSI_MAX - 1) ed.csi[ed.csi_len++] = c;
+        return;
+    }
+    ed.esc = 0;
+    ed.csi[ed.csi_len] = '\0';
+    if (c == 'C') move_to(next_char(ed.cursor));
+    else if (c == 'D') move_to(prev_char(ed.cursor));
+    else if (c == 'H' || (c == '~' && (!strcmp(ed.csi, "1") || !strcmp(ed.csi, "7")))) move_to(0);
+    else if (c == 'F' || (c == '~' && (!strcmp(ed.csi, "4") || !strcmp(ed.csi, "8")))) move_to(ed.len);
+    else if (c == '~' && !strcmp(ed.csi, "3")) delete_range(ed.cursor, next_char(ed.cursor));
+}
+
+static void handle_byte(unsigned char c) {
+    int first = ed.fresh;
+    ed.fresh = 0;
+    if (ed.literal) {
+        ed.literal = 0;
+        if (c != '\0') insert_byte(c);
+        return;
+    }
+    if (ed.esc) {
+        handle_escape(c);
+        return;
+    }
+    switch (c) {
+    case '\r':
+    case '\n':
+        ed.done = 1;
+        break;
+    case '\0':
+        // A Ctrl+D typed ahead while a command ran was queued by the
+        // terminal in canonical mode, which stores it as a NUL. Typed
+        // at the prompt, NUL is Ctrl+@ or Ctrl+Space, which has no binding.
+        if (first) ed.done = ed.eof = 1;
+        break;
+    case KEY_CTRL('D'):
+        if (ed.len == 0) ed.done = ed.eof = 1;
+        else delete_range(ed.cursor, next_char(ed.cursor));
+        break;
+    case KEY_BACKSPACE:
+    case KEY_CTRL('H'):
+        delete_range(prev_char(ed.cursor), ed.cursor);
+        break;
+    case KEY_CTRL('A'): move_to(0); break;
+    case KEY_CTRL('E'): move_to(ed.len); break;
+    case KEY_CTRL('B'): move_to(prev_char(ed.cursor)); break;
+    case KEY_CTRL('F'): move_to(next_char(ed.cursor)); break;
+    case KEY_CTRL('U'): delete_range(0, ed.cursor); break;
+    case KEY_CTRL('K'): delete_range(ed.cursor, ed.len); break;
+    case KEY_CTRL('W'): delete_range(word_start(ed.cursor), ed.cursor); break;
+    case KEY_CTRL('V'): ed.literal = 1; break;
+    case KEY_CTRL('L'):
+        emit("\033[H\033[2J", 7);
+        ed.cursor_row = 0;
+        redraw();
+        break;
+    case '\033':
+        ed.esc = 1;
+        break;
+    default:
+        // Other control characters have no binding and are ignored.
+        if (c >= 0x20 || c == '\t') insert_byte(c);
+    }
+}
+
+/* ---------------- EVENTS ---------------- */
+
+static void on_input(void *arg) {
+    int avail = 0;
+    if (ioctl(STDIN_FILENO, FIONREAD, &avail) < 0 || avail < 1) avail = 1;
+    for (; avail > 0 && !ed.done; avail--) {
+        unsigned char c;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) return;
+        if (n <= 0) { // Hangup or error: nothing more will come
+            ed.done = ed.eof = 1;
+            return;
+        }
+        handle_byte(c);
+    }
+}
+
+static void on_child(void *arg) {
+    check_jobs();
+    if (!has_completed_jobs()) return;
+    editor_hide();
+    print_completed_jobs();
+    editor_show();
+}
+
+static void on_signal(void *arg) {
+    int sig;
+    while ((sig = read_signal()) != 0) {
+        if (sig != SIGINT || !ed.active) continue; // Ctrl+Z at the prompt does nothing
+        // Like other shells: show ^C, drop the line and prompt again.
+        if (ed.cursor != ed.len) move_to(ed.len);
+        emit("^C\n", 3);
+        ed.cursor_row = 0;
+        ed.len = ed.cursor = 0;
+        ed.esc = ed.literal = 0;
+        redraw();
+    }
+}
+
+static void set_raw(int raw) {
+    struct termios t = saved_tty;
+    if (raw) {
+        t.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+        t.c_cc[VMIN] = 1;
+        t.c_cc[VTIME] = 0;
+    }
+    // TCSADRAIN keeps anything typed ahead, which TCSAFLUSH would drop.
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &t);
+}
+
+int editor_available(void) {
+    if (state == 0) {
+        state = -1;
+        if (isatty(STDIN_FILENO) && isatty(STDOUT_FILENO) &&
+            tcgetattr(STDIN_FILENO, &saved_tty) == 0 &&
+            loop_watch(STDIN_FILENO, on_input, NULL) == 0) {
+            state = 1;
+            if (jobs_signal_fd() >= 0) loop_watch(jobs_signal_fd(), on_child, NULL);
+            if (signals_fd() >= 0) loop_watch(signals_fd(), on_signal, NULL);
+        }
+    }
+    return state == 1;
+}
+
+char *editor_read_line(void) {
+    ed.len = ed.cursor = 0;
+    ed.done = ed.eof = ed.esc = ed.literal = 0;
+    size_t plen;
+    const char *prompt = current_prompt(&plen);
+    size_t pw = text_width(prompt, plen);
+    ed.cursor_row = pw ? (pw - 1) / term_cols() : 0; // main has printed the prompt
+    ed.active = 1;
+    set_raw(1);
+    int queued = 0;
+    ed.fresh = ioctl(STDIN_FILENO, FIONREAD, &queued) == 0 && queued > 0;
+
+    while (!ed.done) {
+        if (loop_run_once(-1) < 0) {
+            perror("epoll_wait");
+            ed.eof = 1;
+            break;
+        }
+    }
+
+    ed.active = 0;
+    if (!ed.eof) {
+        if (ed.cursor != ed.len) move_to(ed.len);
+        emit("\n", 1); // Echoed as the terminal would, \r\n with output processing
+        flush_out();
+    }
+    set_raw(0);
+    if (ed.eof) return NULL;
+    if (!ed.buf && !(ed.buf = malloc(1))) return NULL;
+    ed.buf[ed.len] = '\0';
+    return ed.buf;
+}
+
+void editor_hide(void) {
+    if (!ed.active) return;
+    clear_line();
+    flush_out();
+}
+
+void editor_show(void) {
+    if (!ed.active) return;
+    fflush(stdout);
+    redraw();
+}
+
+void cleanup_editor(void) {
+    if (state == 1) {
+        loop_unwatch(STDIN_FILENO);
+        if (jobs_signal_fd() >= 0) loop_unwatch(jobs_signal_fd());
+        if (signals_fd() >= 0) loop_unwatch(signals_fd());
+    }
+    state = 0;
+    free(ed.buf);
+    free(out);
+    memset(&ed, 0, sizeof(ed));
+    out = NULL;
+    out_len = out_cap = 0;
+}
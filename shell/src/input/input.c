@@ -3,14 +3,31 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-char *read_input() {
-    char *line = NULL;
-    size_t len = 0;
+#include "arena.h"
+#include "input/editor.h"
+#include "exotic/signals.h"
+
+// The line buffer is kept between calls so steady-state input needs no
+// heap calls; getline only grows it for a longer line.
+static char *line = NULL;
+static size_t len = 0;
+
+// Input that is not a terminal (a pipe, or a file that epoll cannot
+// watch) is read as plain lines.
+static char *read_plain_line(void) {
     ssize_t nread = getline(&line, &len, stdin);
 
     if (nread == -1) {
         free(line);
+        line = NULL;
+        len = 0;
         return NULL; // EOF or error
     }
 
@@ -19,5 +36,130 @@ char *read_input() {
         line[nread - 1] = '\0';
     }
 
-    return line; // Caller must free
+    return line; // Valid until the next call; do not free
+}
+
+char *read_input() {
+    // Ctrl+C and Ctrl+Z at the prompt are read from a signalfd rather than
+    // interrupting the read (which getline would take for end of input).
+    signals_to_fd(1);
+    char *result = editor_available() ? editor_read_line() : read_plain_line();
+    signals_to_fd(0);
+    return result;
+}
+
+/* ---------------- SCRIPT INPUT ---------------- */
+
+// A regular file is mmap'd so the whole script costs one syscall to load
+// instead of one read per line; anything else (a pipe, /dev/stdin) is read
+// into a heap buffer by read_whole_fd.
+static const char *script = NULL;
+static size_t script_size = 0;
+static size_t script_pos = 0;
+static int script_mapped = 0;
+static int script_owned = 0;  // Heap buffer from read_all
+
+char *read_whole_fd(int fd, size_t *size_out, volatile sig_atomic_t *stop) {
+    size_t cap = 64 * 1024;
+    char *buf = malloc(cap);
+    if (!buf) return NULL;
+
+    size_t size = 0;
+    while (1) {
+        if (size == cap) {
+            char *bigger = realloc(buf, cap * 2);
+            if (!bigger) {
+                free(buf);
+                return NULL;
+            }
+            buf = bigger;
+            cap *= 2;
+        }
+        if (stop && *stop) {
+            free(buf);
+            errno = EINTR;
+            return NULL;
+        }
+        ssize_t n = read(fd, buf + size, cap - size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            int saved = errno;
+            free(buf);
+            errno = saved;
+            return NULL;
+        }
+        if (n == 0) break;
+        size += n;
+    }
+    *size_out = size;
+    return buf;
+}
+
+static int read_all(int fd) {
+    char *buf = read_whole_fd(fd, &script_size, NULL);
+    if (!buf) return -1;
+    script = buf;
+    script_owned = 1;
+    return 0;
+}
+
+int open_script(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("No such file or directory\n");
+        return -1;
+    }
+
+    struct stat st;
+    int result = 0;
+    script_pos = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+            script = map;
+            script_size = st.st_size;
+            script_mapped = 1;
+        } else {
+            result = read_all(fd);
+        }
+    } else if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        script = "";
+        script_size = 0;
+    } else {
+        result = read_all(fd);
+    }
+    if (result < 0) perror("read");
+    close(fd);
+    return result;
+}
+
+void open_script_string(const char *text) {
+    script = text;
+    script_size = strlen(text);
+    script_pos = 0;
+}
+
+char *read_script_line(void) {
+    if (!script || script_pos >= script_size) return NULL;
+
+    const char *start = script + script_pos;
+    size_t left = script_size - script_pos;
+    const char *nl = memchr(start, '\n', left);
+    size_t len = nl ? (size_t)(nl - start) : left;
+    script_pos += nl ? len + 1 : len;
+
+    char *copy = arena_strndup(&line_arena, start, len);
+    return copy ? copy : "";
+}
+
+void close_script(void) {
+    if (script_mapped) {
+        munmap((void *)script, script_size);
+    } else if (script_owned) {
+        free((void *)script);
+    }
+    script = NULL;
+    script_size = script_pos = 0;
+    script_mapped = script_owned = 0;
 }
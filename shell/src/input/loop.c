@@ -0,0 +1,105 @@
+#define _GNU_SOURCE
+#include "input/loop.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+/*
+The shell's event loop: one epoll set over everything it may have to
+react to while waiting for input, which is the terminal, the signalfds
+(SIGCHLD from the job table, SIGINT/SIGTSTP from signals.c).
+Handlers run from loop_run_once, never from a signal handler, so they
+can print, allocate and touch the job table freely.
+
+A watch can be removed from inside a handler, even one for an event later
+in the same batch: it is only marked dead then, and freed after the batch.
+*/
+
+#define LOOP_MAX_EVENTS 16
+
+typedef struct Watch {
+    int fd;
+    int dead;
+    EventHandler fn;
+    void *arg;
+    struct Watch *next;
+} Watch;
+
+static int epoll_fd = -1;
+static Watch *watches = NULL;
+static int dispatching = 0;
+
+static int open_loop(void) {
+    if (epoll_fd < 0) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0) perror("epoll_create1");
+    }
+    return epoll_fd;
+}
+
+static Watch *add_watch(int fd, EventHandler fn, void *arg) {
+    if (open_loop() < 0) return NULL;
+    Watch *w = malloc(sizeof(Watch));
+    if (!w) {
+        perror("malloc");
+        return NULL;
+    }
+    *w = (Watch){ fd, 0, fn, arg, watches };
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = w };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        free(w);
+        return NULL;
+    }
+    watches = w;
+    return w;
+}
+
+static void free_dead(void) {
+    for (Watch **p = &watches; *p;) {
+        Watch *w = *p;
+        if (w->dead) {
+            *p = w->next;
+            free(w);
+        } else {
+            p = &w->next;
+        }
+    }
+}
+
+int loop_watch(int fd, EventHandler fn, void *arg) {
+    return add_watch(fd, fn, arg) ? 0 : -1;
+}
+
+void loop_unwatch(int fd) {
+    for (Watch *w = watches; w; w = w->next) {
+        if (w->dead || w->fd != fd) continue;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        w->dead = 1;
+    }
+    if (!dispatching) free_dead();
+}
+
+int loop_run_once(int timeout_ms) {
+    if (open_loop() < 0) return -1;
+    struct epoll_event events[LOOP_MAX_EVENTS];
+    int n = epoll_wait(epoll_fd, events, LOOP_MAX_EVENTS, timeout_ms);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+
+    dispatching = 1;
+    for (int i = 0; i < n; i++) {
+        Watch *w = events[i].data.ptr;
+        if (!w->dead) w->fn(w->arg);
+    }
+    dispatching = 0;
+    free_dead();
+    return n;
+}
+
+void cleanup_loop(void) {
+    for (Watch *w = watches; w; w = w->next) w->dead = 1;
+    free_dead();
+    if (epoll_fd >= 0) close(epoll_fd);
+    epoll_fd = -1;
+}
@@ -1,5 +1,6 @@
 #define _POSIX_C_SOURCE 200809L
 #include "input/parser.h"
+#include "arena.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,12 +21,14 @@ typedef enum {
 typedef struct {
     TokenType type;
     char *value;
+    size_t start, end; // Offsets of the token in the source line
 } Token;
 
 typedef struct {
     Token *tokens;
     size_t pos;
     size_t size;
+    const char *line;
 } TokenStream;
 
 /* ---------------- TOKENIZER ---------------- */
@@ -40,7 +43,7 @@ static Token *tokenize(const char *line, size_t *count) {
 
         if (*p == '\0') break;
 
-        Token tok = {TOK_INVALID, NULL};
+        Token tok = {TOK_INVALID, NULL, p - line, 0};
 
         if (*p == '|') { tok.type = TOK_PIPE; p++; }
         else if (*p == ';') { tok.type = TOK_SEMICOLON; p++; }
@@ -57,26 +60,26 @@ static Token *tokenize(const char *line, size_t *count) {
                    *p!='|' && *p!=';' && *p!='&' && *p!='<' && *p!='>') {
                 p++;
             }
-            size_t n = p - start;
-            char *val = malloc(n+1);
-            strncpy(val, start, n);
-            val[n] = '\0';
             tok.type = TOK_NAME;
-            tok.value = val;
+            tok.value = arena_strndup(&line_arena, start, p - start);
+            if (!tok.value) return NULL;
         }
+        tok.end = p - line;
 
         if (len == cap) {
+            tokens = arena_realloc(&line_arena, tokens, cap * sizeof(Token), (cap ? cap*2 : 8) * sizeof(Token));
+            if (!tokens) return NULL;
             cap = cap ? cap*2 : 8;
-            tokens = realloc(tokens, cap * sizeof(Token));
         }
         tokens[len++] = tok;
     }
 
     // End marker
-    Token endtok = {TOK_END, NULL};
+    Token endtok = {TOK_END, NULL, p - line, p - line};
     if (len == cap) {
+        tokens = arena_realloc(&line_arena, tokens, cap * sizeof(Token), (cap ? cap*2 : 8) * sizeof(Token));
+        if (!tokens) return NULL;
         cap = cap ? cap*2 : 8;
-        tokens = realloc(tokens, cap * sizeof(Token));
     }
     tokens[len++] = endtok;
 
@@ -84,6 +87,53 @@ static Token *tokenize(const char *line, size_t *count) {
     return tokens;
 }
 
+/* ---------------- TREE BUILDING ---------------- */
+
+// All nodes live in the line arena and are released with it.
+
+// Vectors grow through powers of two from 8 up, so appending one element at
+// a time copies each element O(1) times even for 100k-argument commands.
+static int vec_capacity(int n) {
+    int cap = 8;
+    while (cap < n) cap *= 2;
+    return cap;
+}
+
+// Grows *items (of *count elements) by one zeroed element and returns it.
+static void *grow(void **items, int *count, size_t item_size) {
+    if (!*items || *count == vec_capacity(*count)) {
+        size_t cap = vec_capacity(*count + 1);
+        void *bigger = arena_realloc(&line_arena, *items, *count * item_size, cap * item_size);
+        if (!bigger) return NULL;
+        *items = bigger;
+    }
+    char *slot = (char *)*items + (*count)++ * item_size;
+    memset(slot, 0, item_size);
+    return slot;
+}
+
+static int add_arg(SimpleCommand *cmd, Token *t) {
+    // Keep room for the terminating NULL.
+    int used = cmd->argc + 1;
+    if (!cmd->argv || used == vec_capacity(used)) {
+        char **argv = arena_realloc(&line_arena, cmd->argv, used * sizeof(char *),
+                                    vec_capacity(used + 1) * sizeof(char *));
+        if (!argv) return 0;
+        cmd->argv = argv;
+    }
+    cmd->argv[cmd->argc++] = t->value;
+    cmd->argv[cmd->argc] = NULL;
+    return 1;
+}
+
+static int add_redir(SimpleCommand *cmd, TokenType op, Token *target) {
+    Redirection *r = grow((void **)&cmd->redirs, &cmd->nredirs, sizeof(Redirection));
+    if (!r) return 0;
+    r->type = op == TOK_INPUT ? REDIR_INPUT : (op == TOK_APPEND ? REDIR_APPEND : REDIR_OUTPUT);
+    r->target = target->value;
+    return 1;
+}
+
 /* ---------------- PARSER (recursive descent) ---------------- */
 
 static Token *peek(TokenStream *ts) {
@@ -100,57 +150,55 @@ static Token *consume(TokenStream *ts, TokenType type) {
     return NULL;
 }
 
-static int parse_name(TokenStream *ts) {
-    return consume(ts, TOK_NAME) != NULL;
-}
-
-static int parse_input(TokenStream *ts) {
-    Token *t = peek(ts);
-    if (t && t->type == TOK_INPUT) {
-        ts->pos++;
-        return parse_name(ts);
-    }
-    return 0;
-}
-
-static int parse_output(TokenStream *ts) {
-    Token *t = peek(ts);
-    if (t && (t->type == TOK_OUTPUT || t->type == TOK_APPEND)) {
-        ts->pos++;
-        return parse_name(ts);
-    }
-    return 0;
+static int is_redirect(TokenType type) {
+    return type == TOK_INPUT || type == TOK_OUTPUT || type == TOK_APPEND;
 }
 
-static int parse_atomic(TokenStream *ts) {
-    if (!parse_name(ts)) return 0;
+// atomic : name (name | input | output)*
+// A redirection operator must be followed by a file name.
+static int parse_atomic(TokenStream *ts, SimpleCommand *cmd) {
+    Token *t = consume(ts, TOK_NAME);
+    if (!t || !add_arg(cmd, t)) return 0;
 
     while (1) {
-        if (peek(ts)->type == TOK_NAME) { ts->pos++; }
-        else if (parse_input(ts)) {}
-        else if (parse_output(ts)) {}
-        else break;
+        t = peek(ts);
+        if (t->type == TOK_NAME) {
+            ts->pos++;
+            if (!add_arg(cmd, t)) return 0;
+        } else if (is_redirect(t->type)) {
+            ts->pos++;
+            Token *target = consume(ts, TOK_NAME);
+            if (!target || !add_redir(cmd, t->type, target)) return 0;
+        } else {
+            break;
+        }
     }
     return 1;
 }
 
-static int parse_cmd_group(TokenStream *ts) {
-    if (!parse_atomic(ts)) return 0;
-    while (consume(ts, TOK_PIPE)) {
-        if (!parse_atomic(ts)) return 0;
-    }
-    return 1;
+// cmd_group : atomic ('|' atomic)*
+static int parse_cmd_group(TokenStream *ts, CommandLine *cl) {
+    Pipeline *pl = grow((void **)&cl->pipelines, &cl->npipelines, sizeof(Pipeline));
+    if (!pl) return 0;
+    size_t start = peek(ts)->start;
+
+    do {
+        SimpleCommand *cmd = grow((void **)&pl->cmds, &pl->ncmds, sizeof(SimpleCommand));
+        if (!cmd || !parse_atomic(ts, cmd)) return 0;
+    } while (consume(ts, TOK_PIPE));
+
+    size_t end = ts->tokens[ts->pos - 1].end;
+    pl->text = arena_strndup(&line_arena, ts->line + start, end - start);
+    return pl->text != NULL;
 }
 
-// *** THIS IS THE FIXED FUNCTION ***
-static int parse_shell_cmd(TokenStream *ts) {
+static int parse_shell_cmd(TokenStream *ts, CommandLine *cl) {
     // A shell command must start with at least one command group.
-    if (!parse_cmd_group(ts)) return 0;
+    if (!parse_cmd_group(ts, cl)) return 0;
 
     // Loop through any number of commands separated by '&' or ';'.
     while (peek(ts)->type == TOK_SEMICOLON || peek(ts)->type == TOK_AMPERSAND) {
         
-        // ** THE FIX IS HERE **
         // Before consuming the separator, peek ahead. If the token *after*
         // the separator is the end of the input, then it's a valid trailing
         // separator. We break the loop and let the final check handle it.
@@ -158,16 +206,18 @@ static int parse_shell_cmd(TokenStream *ts) {
             break;
         }
 
-        ts->pos++; // Consume the separator ('&' or ';').
+        // An '&' separator sends the group before it to the background.
+        Token *sep = &ts->tokens[ts->pos++];
+        if (sep->type == TOK_AMPERSAND) cl->pipelines[cl->npipelines - 1].is_background = 1;
 
         // After a separator that is NOT at the end, another command group is REQUIRED.
         // If it's missing, that's a syntax error (e.g., "ls ; ; pwd").
-        if (!parse_cmd_group(ts)) return 0;
+        if (!parse_cmd_group(ts, cl)) return 0;
     }
 
     // After the loop, we might have a trailing '&' or ';'. The grammar specifically
     // allows a final '&'. We will also allow a final ';' for robustness.
-    consume(ts, TOK_AMPERSAND);
+    if (consume(ts, TOK_AMPERSAND)) cl->pipelines[cl->npipelines - 1].is_background = 1;
     consume(ts, TOK_SEMICOLON);
 
     // The command is valid only if we have now reached the end of the token stream.
@@ -176,16 +226,16 @@ static int parse_shell_cmd(TokenStream *ts) {
 
 /* ---------------- PUBLIC ---------------- */
 
-int parse_command(const char *line) {
+CommandLine *parse_command(const char *line) {
     size_t count;
     Token *toks = tokenize(line, &count);
-    TokenStream ts = {toks, 0, count};
+    if (!toks) return NULL; // Out of memory, already reported
+    TokenStream ts = {toks, 0, count, line};
 
-    int ok = parse_shell_cmd(&ts);
+    CommandLine *cl = arena_alloc(&line_arena, sizeof(CommandLine));
+    if (!cl) return NULL;
+    cl->pipelines = NULL;
+    cl->npipelines = 0;
 
-    // free allocated NAME values
-    for (size_t i=0; i<count; i++) free(toks[i].value);
-    free(toks);
-
-    return ok;
-}
\ No newline at end of file
+    return parse_shell_cmd(&ts, cl) ? cl : NULL;
+}
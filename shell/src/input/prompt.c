@@ -7,8 +7,25 @@
 #include <pwd.h>
 #include <string.h>
 #include <limits.h>
+#include <sys/stat.h>
 
-void show_prompt() {
+/*
+The "<user@host:" part never changes, so it is looked up once (getpwuid can
+go through NSS and parse /etc/passwd). The full prompt is cached and only
+rebuilt when hop reports a directory change, or when the working directory's
+inode no longer matches the one the prompt was built for. Like $PWD in other
+shells, a rename of the current directory is not noticed until the next hop.
+*/
+
+static char prompt_head[LOGIN_NAME_MAX + HOST_NAME_MAX + 8]; // "<user@host:"
+static size_t prompt_head_len = 0;
+static char prompt_buf[sizeof(prompt_head) + PATH_MAX + 4];
+static size_t prompt_len = 0;
+static int prompt_valid = 0;
+static dev_t prompt_dev;
+static ino_t prompt_ino;
+
+void init_prompt() {
     // Username
     struct passwd *pw = getpwuid(getuid());
     const char *username = pw ? pw->pw_name : "unknown";
@@ -18,7 +35,18 @@ void show_prompt() {
     if (gethostname(hostname, sizeof(hostname)) != 0) {
         strcpy(hostname, "unknown");
     }
+    hostname[HOST_NAME_MAX] = '\0';
+
+    int n = snprintf(prompt_head, sizeof(prompt_head), "<%s@%s:", username, hostname);
+    prompt_head_len = (n < 0) ? 0 : ((size_t)n >= sizeof(prompt_head) ? sizeof(prompt_head) - 1 : (size_t)n);
+    prompt_valid = 0;
+}
 
+void invalidate_prompt() {
+    prompt_valid = 0;
+}
+
+static void build_prompt(void) {
     // Current working directory
     char cwd[PATH_MAX];
     if (!getcwd(cwd, sizeof(cwd))) {
@@ -28,17 +56,49 @@ void show_prompt() {
     // *** FIX: Get the canonical home directory from the hop module to ensure consistency. ***
     const char *home_dir = get_home_dir();
     const char *display_path = cwd;
+    const char *tilde = "";
 
     if (home_dir) {
         size_t home_len = strlen(home_dir);
         // *** FIX: Stricter check to ensure it's a real subdirectory, not a partial name match. ***
         if (strncmp(cwd, home_dir, home_len) == 0 && (cwd[home_len] == '/' || cwd[home_len] == '\0')) {
-            static char path_buf[PATH_MAX];
-            snprintf(path_buf, sizeof(path_buf), "~%s", cwd + home_len);
-            display_path = path_buf;
+            tilde = "~";
+            display_path = cwd + home_len;
         }
     }
 
-    printf("<%s@%s:%s> ", username, hostname, display_path);
+    int n = snprintf(prompt_buf, sizeof(prompt_buf), "%s%s%s> ", prompt_head, tilde, display_path);
+    prompt_len = (n < 0) ? 0 : ((size_t)n >= sizeof(prompt_buf) ? sizeof(prompt_buf) - 1 : (size_t)n);
+}
+
+const char *current_prompt(size_t *len) {
+    if (prompt_head_len == 0) init_prompt();
+
+    // Cheap check for a chdir() made anywhere other than hop.
+    struct stat st;
+    if (stat(".", &st) != 0) {
+        prompt_valid = 0;
+    } else if (prompt_valid && (st.st_dev != prompt_dev || st.st_ino != prompt_ino)) {
+        prompt_valid = 0;
+    }
+
+    if (!prompt_valid) {
+        build_prompt();
+        prompt_dev = st.st_dev;
+        prompt_ino = st.st_ino;
+        prompt_valid = 1;
+    }
+    *len = prompt_len;
+    return prompt_buf;
+}
+
+void show_prompt() {
+    size_t len;
+    const char *prompt = current_prompt(&len);
+
+    // Anything still buffered must go out before the prompt.
     fflush(stdout);
-}
\ No newline at end of file
+    if (write(STDOUT_FILENO, prompt, len) < 0) {
+        perror("write");
+    }
+}
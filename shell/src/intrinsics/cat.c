@@ -0,0 +1,79 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "intrinsics/cat.h"
+#include "redirect/copy.h"
+#include "exotic/signals.h"
+#include "cmd_exec.h"
+
+/*
+cat without the fork and exec, and without the copy through user space
+(see copy_fd). Only the plain form is handled: options are left to the
+real cat, and so is reading from a terminal, which has to be a separate
+process so that Ctrl+Z and Ctrl+C act on it as usual.
+
+Errors go to stderr, since stdout is usually the file being written.
+*/
+
+// True if copying fd to stdout would read back what it writes, as with
+// "cat a >> a": the same regular file, with input left to read at or
+// after the point where the output goes.
+static int overlaps_output(int fd) {
+    struct stat in, out;
+    if (fstat(fd, &in) < 0 || fstat(STDOUT_FILENO, &out) < 0) return 0;
+    if (!S_ISREG(in.st_mode) || in.st_dev != out.st_dev || in.st_ino != out.st_ino) return 0;
+    off_t in_pos = lseek(fd, 0, SEEK_CUR);
+    if (in_pos < 0 || in_pos >= in.st_size) return 0;
+    int flags = fcntl(STDOUT_FILENO, F_GETFL);
+    return (flags >= 0 && (flags & O_APPEND)) || lseek(STDOUT_FILENO, 0, SEEK_CUR) < in.st_size;
+}
+
+// Copies one input to stdout; name is only used in messages.
+static int cat_fd(int fd, const char *name) {
+    if (overlaps_output(fd)) {
+        fprintf(stderr, "cat: %s: input file is output file\n", name);
+        return 1;
+    }
+    if (copy_fd(fd, STDOUT_FILENO, &g_sigint_pending) < 0) {
+        if (errno != EINTR) fprintf(stderr, "cat: %s: %s\n", name, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+int cat_command(int argc, char **argv) {
+    int uses_stdin = argc == 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-") == 0) {
+            uses_stdin = 1;
+        } else if (argv[i][0] == '-') {
+            return RUN_EXTERNAL; // An option
+        }
+    }
+    if (uses_stdin && isatty(STDIN_FILENO)) return RUN_EXTERNAL;
+
+    fflush(stdout); // Anything printed earlier goes first.
+    g_sigint_pending = 0;
+    int result = 0;
+    if (argc == 1) return cat_fd(STDIN_FILENO, "-");
+
+    for (int i = 1; i < argc && !g_sigint_pending; i++) {
+        if (strcmp(argv[i], "-") == 0) {
+            result |= cat_fd(STDIN_FILENO, "-");
+            continue;
+        }
+        int fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "cat: %s: %s\n", argv[i], strerror(errno));
+            result = 1;
+            continue;
+        }
+        result |= cat_fd(fd, argv[i]);
+        close(fd);
+    }
+    return result;
+}
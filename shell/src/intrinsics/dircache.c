@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include "intrinsics/dircache.h"
+#include "intrinsics/reveal.h"
+
+/*
+A bounded LRU cache of sorted directory listings, keyed by (dev, inode)
+so that every path to a directory shares one entry. reveal lists through
+it, and command lookup checks $PATH directories against it instead of
+stat'ing a candidate file in each.
+
+An entry is dropped as soon as the directory changes. Each one gets an
+inotify watch, added before the directory is read so nothing can slip in
+between; pending events are read (without blocking) on every lookup.
+Where a watch cannot be had, the directory's mtime is compared instead,
+and a listing read within DIRCACHE_RACY_NS of the last change is not
+trusted, since a second change in the same timestamp tick would not
+show.
+
+Entries in use are reference counted and never evicted; one too big for
+the cache is handed out uncached and freed on release.
+*/
+
+#define DIRCACHE_MAX_BYTES (16 * 1024 * 1024)
+#define DIRCACHE_MAX_ENTRIES 128
+#define DIRCACHE_RACY_NS 1000000000LL
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+struct CachedDir {
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    int racy;            // Read too soon after a change to trust the mtime
+    int wd;              // inotify watch, or -1
+    NameList list;
+    size_t bytes;
+    int refs;
+    int cached;          // Linked into the LRU list
+    CachedDir *prev;     // Towards the most recently used
+    CachedDir *next;
+};
+
+typedef struct {
+    unsigned long lookups;
+    unsigned long hits;
+    unsigned long invalidations;
+    unsigned long evictions;
+} CacheStats;
+
+static CachedDir *lru_head = NULL;   // Most recently used
+static CachedDir *lru_tail = NULL;
+static size_t cached_count = 0;
+static size_t cached_bytes = 0;
+static int inotify_fd = -2;          // -2 = not opened yet, -1 = unavailable
+static CacheStats stats;
+
+static long long ts_ns(struct timespec ts) {
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ---------------- ENTRIES ---------------- */
+
+static void unlink_entry(CachedDir *dir) {
+    if (!dir->cached) return;
+    if (dir->prev) dir->prev->next = dir->next; else lru_head = dir->next;
+    if (dir->next) dir->next->prev = dir->prev; else lru_tail = dir->prev;
+    dir->prev = dir->next = NULL;
+    dir->cached = 0;
+    cached_count--;
+    cached_bytes -= dir->bytes;
+}
+
+static void push_front(CachedDir *dir) {
+    dir->prev = NULL;
+    dir->next = lru_head;
+    if (lru_head) lru_head->prev = dir; else lru_tail = dir;
+    lru_head = dir;
+    dir->cached = 1;
+    cached_count++;
+    cached_bytes += dir->bytes;
+}
+
+static void free_entry(CachedDir *dir) {
+    if (dir->wd >= 0 && inotify_fd >= 0) inotify_rm_watch(inotify_fd, dir->wd);
+    free_names(&dir->list);
+    free(dir);
+}
+
+// Takes dir out of the cache; it is freed now, or on its last release.
+static void drop_entry(CachedDir *dir) {
+    unlink_entry(dir);
+    if (dir->refs == 0) free_entry(dir);
+}
+
+static void evict_to_fit(void) {
+    CachedDir *dir = lru_tail;
+    while (dir && (cached_bytes > DIRCACHE_MAX_BYTES || cached_count > DIRCACHE_MAX_ENTRIES)) {
+        CachedDir *prev = dir->prev;
+        if (dir->refs == 0) {
+            drop_entry(dir);
+            stats.evictions++;
+        }
+        dir = prev;
+    }
+}
+
+static CachedDir *find_entry(dev_t dev, ino_t ino) {
+    for (CachedDir *dir = lru_head; dir; dir = dir->next) {
+        if (dir->dev == dev && dir->ino == ino) return dir;
+    }
+    return NULL;
+}
+
+/* ---------------- INVALIDATION ---------------- */
+
+static void open_inotify(void) {
+    if (inotify_fd != -2) return;
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+// Drops every entry whose directory has changed since it was read.
+static void drain_events(void) {
+    if (inotify_fd < 0) return;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    while ((n = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) { // Lost track: trust nothing
+                while (lru_head) {
+                    stats.invalidations++;
+                    drop_entry(lru_head);
+                }
+                continue;
+            }
+            for (CachedDir *dir = lru_head; dir; dir = dir->next) {
+                if (dir->wd != ev->wd) continue;
+                if (ev->mask & IN_IGNORED) dir->wd = -1; // The watch is gone already
+                stats.invalidations++;
+                drop_entry(dir);
+                break;
+            }
+        }
+    }
+}
+
+static int still_valid(const CachedDir *dir, const struct stat *st) {
+    if (ts_ns(st->st_mtim) != ts_ns(dir->mtime)) return 0;
+    return dir->wd >= 0 || !dir->racy;
+}
+
+static void add_watch(CachedDir *dir, int dir_fd) {
+    dir->wd = -1;
+    open_inotify();
+    if (inotify_fd < 0) return;
+    char proc_path[64];
+    snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", dir_fd);
+    dir->wd = inotify_add_watch(inotify_fd, proc_path, WATCH_MASK);
+}
+
+/* ---------------- API ---------------- */
+
+static CachedDir *read_entry(int dir_fd, const struct stat *st) {
+    CachedDir *dir = calloc(1, sizeof(CachedDir));
+    if (!dir) return NULL;
+    dir->dev = st->st_dev;
+    dir->ino = st->st_ino;
+    dir->mtime = st->st_mtim;
+
+    // Watch first: a change made while reading still gets reported.
+    add_watch(dir, dir_fd);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    dir->racy = ts_ns(now) - ts_ns(st->st_mtim) < DIRCACHE_RACY_NS;
+
+    if (lseek(dir_fd, 0, SEEK_SET) < 0 || read_names(dir_fd, 1, &dir->list) < 0) {
+        int saved = errno;
+        free_entry(dir);
+        errno = saved;
+        return NULL;
+    }
+    radix_sort(dir->list.names, dir->list.count, 0);
+    dir->bytes = sizeof(CachedDir) + arena_stats(&dir->list.arena)->reserved +
+                 dir->list.cap * sizeof(char *);
+    return dir;
+}
+
+CachedDir *dircache_get(int dir_fd) {
+    struct stat st;
+    if (fstat(dir_fd, &st) < 0) return NULL;
+    stats.lookups++;
+    drain_events();
+
+    CachedDir *dir = find_entry(st.st_dev, st.st_ino);
+    if (dir && still_valid(dir, &st)) {
+        stats.hits++;
+        unlink_entry(dir);
+        push_front(dir);
+        dir->refs++;
+        return dir;
+    }
+    if (dir) {
+        stats.invalidations++;
+        drop_entry(dir);
+    }
+
+    dir = read_entry(dir_fd, &st);
+    if (!dir) return NULL;
+    // The getdents buffer is only needed while reading.
+    free(dir->list.dirent_buf);
+    dir->list.dirent_buf = NULL;
+
+    dir->refs = 1;
+    if (dir->bytes <= DIRCACHE_MAX_BYTES / 2) {
+        push_front(dir);
+        evict_to_fit();
+    }
+    return dir;
+}
+
+char *const *dircache_names(const CachedDir *dir, size_t *count) {
+    *count = dir->list.count;
+    return dir->list.names;
+}
+
+void dircache_release(CachedDir *dir) {
+    if (--dir->refs == 0 && !dir->cached) free_entry(dir);
+}
+
+int dircache_contains(int dir_fd, const char *name) {
+    CachedDir *dir = dircache_get(dir_fd);
+    if (!dir) return -1;
+    size_t lo = 0, hi = dir->list.count;
+    int found = 0;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(dir->list.names[mid], name);
+        if (cmp == 0) {
+            found = 1;
+            break;
+        }
+        if (cmp < 0) lo = mid + 1; else hi = mid;
+    }
+    dircache_release(dir);
+    return found;
+}
+
+int cache_command(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "stats") == 0) { // cache stats
+        drain_events();
+        unsigned long misses = stats.lookups - stats.hits;
+        printf("listings: %zu (limit %d)\n", cached_count, DIRCACHE_MAX_ENTRIES);
+        printf("memory: %zu bytes (limit %d)\n", cached_bytes, DIRCACHE_MAX_BYTES);
+        printf("lookups: %lu, hits: %lu, misses: %lu, hit rate: %.1f%%\n", stats.lookups,
+               stats.hits, misses, stats.lookups ? 100.0 * stats.hits / stats.lookups : 0.0);
+        printf("invalidations: %lu, evictions: %lu\n", stats.invalidations, stats.evictions);
+        printf("invalidation: %s\n", inotify_fd >= 0 ? "inotify" : "mtime");
+        return 0;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "clear") == 0) { // cache clear
+        for (CachedDir *dir = lru_head; dir;) {
+            CachedDir *next = dir->next;
+            if (dir->refs == 0) drop_entry(dir);
+            dir = next;
+        }
+        return 0;
+    }
+
+    printf("Usage: cache stats | cache clear\n");
+    return 1;
+}
+
+void cleanup_dircache() {
+    while (lru_head) drop_entry(lru_head);
+    if (inotify_fd >= 0) close(inotify_fd);
+    inotify_fd = -2;
+}
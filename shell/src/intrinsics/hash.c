@@ -0,0 +1,316 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "intrinsics/hash.h"
+#include "intrinsics/dircache.h"
+
+/*
+The command hash table maps a command name to the absolute path of its
+executable. It is filled lazily the first time a name is launched, so the
+child can execve() the cached path directly instead of letting execvp() try
+every $PATH directory in turn.
+
+Entries are validated against the mtimes of the $PATH directories. A new or
+removed file changes its directory's mtime, and since a new file in an
+earlier directory may shadow a cached one, a change in directory i drops every
+entry resolved from directory i or later. The directories are re-stat'ed at
+most once per HASH_RECHECK_NS, so a hit normally costs no syscalls at all.
+
+On a miss, each absolute $PATH directory is held open and checked against
+its cached listing (see dircache.c), so only the directory that has the
+name is stat'ed.
+*/
+
+#define HASH_INITIAL_BUCKETS 64
+#define HASH_RECHECK_NS 1000000000LL
+
+typedef struct HashEntry {
+    char *name;
+    char *path;
+    int dir_index;
+    unsigned long hits;
+    struct HashEntry *next;
+} HashEntry;
+
+typedef struct {
+    char *dir;
+    struct timespec mtime;
+    int exists;
+    int fd;              // Open on dir if it is absolute, else -1
+    dev_t dev;
+    ino_t ino;
+} PathDir;
+
+static HashEntry **buckets = NULL;
+static size_t bucket_count = 0;
+static size_t entry_count = 0;
+
+static char *path_snapshot = NULL; // The $PATH value the table was built for
+static PathDir *path_dirs = NULL;
+static int path_dir_count = 0;
+static long long last_check_ns = 0;
+
+static unsigned long hash_string(const char *s) {
+    unsigned long h = 5381;
+    while (*s) h = h * 33 + (unsigned char)*s++;
+    return h;
+}
+
+static long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void free_entry(HashEntry *e) {
+    free(e->name);
+    free(e->path);
+    free(e);
+}
+
+// Drops every entry resolved from directory min_dir or any later one.
+static void drop_entries_from(int min_dir) {
+    for (size_t i = 0; i < bucket_count; i++) {
+        HashEntry **link = &buckets[i];
+        while (*link) {
+            HashEntry *e = *link;
+            if (e->dir_index >= min_dir) {
+                *link = e->next;
+                free_entry(e);
+                entry_count--;
+            } else {
+                link = &e->next;
+            }
+        }
+    }
+}
+
+static void stamp_dir(PathDir *pd) {
+    struct stat st;
+    if (stat(pd->dir, &st) == 0) {
+        pd->mtime = st.st_mtim;
+        pd->exists = 1;
+    } else {
+        pd->exists = 0;
+    }
+
+    // Keep the fd on whatever directory the path names now.
+    if (pd->fd >= 0 && (!pd->exists || st.st_dev != pd->dev || st.st_ino != pd->ino)) {
+        close(pd->fd);
+        pd->fd = -1;
+    }
+    if (pd->fd < 0 && pd->exists && pd->dir[0] == '/') {
+        pd->fd = open(pd->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        pd->dev = st.st_dev;
+        pd->ino = st.st_ino;
+    }
+}
+
+static void free_path_dirs(void) {
+    for (int i = 0; i < path_dir_count; i++) {
+        free(path_dirs[i].dir);
+        if (path_dirs[i].fd >= 0) close(path_dirs[i].fd);
+    }
+    free(path_dirs);
+    free(path_snapshot);
+    path_dirs = NULL;
+    path_snapshot = NULL;
+    path_dir_count = 0;
+}
+
+// Splits $PATH into its directories. An empty component means ".".
+static void load_path_dirs(const char *path_env) {
+    free_path_dirs();
+    path_snapshot = strdup(path_env);
+    if (!path_snapshot) { perror("strdup"); return; }
+
+    int count = 1;
+    for (const char *p = path_env; *p; p++) {
+        if (*p == ':') count++;
+    }
+    path_dirs = calloc(count, sizeof(PathDir));
+    if (!path_dirs) { perror("calloc"); return; }
+
+    const char *start = path_env;
+    while (1) {
+        const char *end = strchr(start, ':');
+        size_t len = end ? (size_t)(end - start) : strlen(start);
+        PathDir *pd = &path_dirs[path_dir_count++];
+        pd->dir = len ? strndup(start, len) : strdup(".");
+        pd->fd = -1;
+        stamp_dir(pd);
+        if (!end) break;
+        start = end + 1;
+    }
+    last_check_ns = monotonic_ns();
+}
+
+// Makes sure the table still matches $PATH and the directory contents.
+static void validate_table(void) {
+    const char *path_env = getenv("PATH");
+    if (!path_env) path_env = "/usr/local/bin:/usr/bin:/bin";
+
+    if (!path_snapshot || strcmp(path_snapshot, path_env) != 0) {
+        drop_entries_from(0);
+        load_path_dirs(path_env);
+        return;
+    }
+
+    long long now = monotonic_ns();
+    if (now - last_check_ns < HASH_RECHECK_NS) return;
+    last_check_ns = now;
+
+    for (int i = 0; i < path_dir_count; i++) {
+        PathDir *pd = &path_dirs[i];
+        PathDir old = *pd;
+        stamp_dir(pd);
+        if (pd->exists != old.exists ||
+            pd->mtime.tv_sec != old.mtime.tv_sec ||
+            pd->mtime.tv_nsec != old.mtime.tv_nsec) {
+            drop_entries_from(i);
+        }
+    }
+}
+
+static int is_executable(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+static void grow_table(void) {
+    size_t new_count = bucket_count ? bucket_count * 2 : HASH_INITIAL_BUCKETS;
+    HashEntry **new_buckets = calloc(new_count, sizeof(HashEntry *));
+    if (!new_buckets) return; // Keep the old table; it only gets slower.
+
+    for (size_t i = 0; i < bucket_count; i++) {
+        HashEntry *e = buckets[i];
+        while (e) {
+            HashEntry *next = e->next;
+            size_t b = hash_string(e->name) & (new_count - 1);
+            e->next = new_buckets[b];
+            new_buckets[b] = e;
+            e = next;
+        }
+    }
+    free(buckets);
+    buckets = new_buckets;
+    bucket_count = new_count;
+}
+
+static HashEntry *find_entry(const char *name) {
+    if (!bucket_count) return NULL;
+    HashEntry *e = buckets[hash_string(name) & (bucket_count - 1)];
+    while (e && strcmp(e->name, name) != 0) e = e->next;
+    return e;
+}
+
+static HashEntry *insert_entry(const char *name, const char *path, int dir_index) {
+    if (entry_count + 1 > bucket_count * 3 / 4) grow_table();
+    if (!bucket_count) return NULL;
+
+    HashEntry *e = malloc(sizeof(HashEntry));
+    if (!e) { perror("malloc"); return NULL; }
+    e->name = strdup(name);
+    e->path = strdup(path);
+    if (!e->name || !e->path) {
+        perror("strdup");
+        free_entry(e);
+        return NULL;
+    }
+    e->dir_index = dir_index;
+    e->hits = 0;
+
+    size_t b = hash_string(name) & (bucket_count - 1);
+    e->next = buckets[b];
+    buckets[b] = e;
+    entry_count++;
+    return e;
+}
+
+// Searches $PATH for name. Hits in relative directories (such as ".") are
+// not cached, since their meaning changes with the working directory.
+static const char *resolve(const char *name, int count_hit) {
+    static char scratch[4096];
+
+    validate_table();
+
+    HashEntry *e = find_entry(name);
+    if (e) {
+        if (count_hit) e->hits++;
+        return e->path;
+    }
+
+    for (int i = 0; i < path_dir_count; i++) {
+        if (!path_dirs[i].exists) continue;
+        if (path_dirs[i].fd >= 0 && dircache_contains(path_dirs[i].fd, name) == 0) continue;
+        int n = snprintf(scratch, sizeof(scratch), "%s/%s", path_dirs[i].dir, name);
+        if (n < 0 || (size_t)n >= sizeof(scratch)) continue;
+        if (!is_executable(scratch)) continue;
+
+        if (path_dirs[i].dir[0] != '/') return scratch;
+        e = insert_entry(name, scratch, i);
+        if (!e) return scratch;
+        if (count_hit) e->hits++;
+        return e->path;
+    }
+    return NULL;
+}
+
+const char *lookup_command_path(const char *name) {
+    if (!name || !*name) return NULL;
+    if (strchr(name, '/')) return name;
+    return resolve(name, 1);
+}
+
+static void print_table(void) {
+    if (entry_count == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+    printf("hits\tcommand\n");
+    for (size_t i = 0; i < bucket_count; i++) {
+        for (HashEntry *e = buckets[i]; e; e = e->next) {
+            printf("%4lu\t%s\n", e->hits, e->path);
+        }
+    }
+}
+
+int hash_command(int argc, char **argv) {
+    if (argc == 1) { // hash
+        validate_table();
+        print_table();
+        return 0;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "-r") == 0) { // hash -r
+        drop_entries_from(0);
+        return 0;
+    }
+
+    int result = 0;
+    for (int i = 1; i < argc; i++) { // hash <name>...
+        if (argv[i][0] == '-') {
+            printf("hash: Invalid flag %s\n", argv[i]);
+            return 1;
+        }
+        if (strchr(argv[i], '/')) continue;
+        if (!resolve(argv[i], 0)) {
+            printf("hash: %s: not found\n", argv[i]);
+            result = 1;
+        }
+    }
+    return result;
+}
+
+void cleanup_hash() {
+    drop_entries_from(0);
+    free(buckets);
+    buckets = NULL;
+    bucket_count = 0;
+    free_path_dirs();
+}
@@ -14,6 +14,7 @@ limits - PATH_MAX etc
 #include <errno.h>
 #include <limits.h> 
 #include "intrinsics/hop.h"
+#include "input/prompt.h"
 
 static char *home_dir = NULL;
 static char *prev_dir = NULL;
@@ -52,6 +53,7 @@ static void change_dir(const char *path) {
             perror("strdup");
             exit(1);
         }
+        invalidate_prompt();
     } else {
         printf("No such directory!\n");
     }
@@ -6,15 +6,75 @@
 #include <limits.h> 
 #include <stdint.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
 #include "intrinsics/log.h"
+#include "intrinsics/log_index.h"
+#include "input/input.h"
 #include "cmd_exec.h"
+#include "arena.h"
+#include "metrics.h"
+
+/*
+The history lives in an append-only file of length-prefixed records:
+
+    "SHLOG01\n" | u32 len, command bytes, u32 len | u32 len, ... | ...
+
+Every command is added with one O_APPEND write, so a crash loses nothing
+and shells sharing the file never overwrite each other. The file is mmap'd
+and read backwards from the end: the trailing length of each record leads
+to the one before it. Record offsets are indexed newest first, and only as
+far back as a lookup needs, so startup and "log execute <n>" cost the same
+however long the file has grown.
+
+Other shells append to the same file. Each session remembers how far it
+has read (log_read_end); when the file has grown, only the records past
+that point are parsed, oldest first, into log_newer. The backward index
+keeps covering what was there before, so nothing is ever re-read.
+
+Only the newest LOG_DEFAULT_RETENTION entries are shown (HISTSIZE overrides
+it, 0 meaning unlimited). Older records are dropped by compaction, which
+runs in a detached process under an exclusive flock and renames the trimmed
+copy over the file; appenders hold a shared lock and reopen the file when
+its inode has changed.
+*/
 
-#define MAX_HISTORY_SIZE 15
 #define LOG_FILENAME "/.shell_log"
+#define LOG_MAGIC "SHLOG01\n"
+#define LOG_HEADER_SIZE 8
+#define LOG_SEARCH_RESULTS 20
+#define LOG_DEFAULT_RETENTION 15
+#define LOG_COMPACT_MIN_BYTES 4096
 
-static char *command_history[MAX_HISTORY_SIZE];
-static int history_count = 0;
 static char log_filepath[1024];
+static int log_fd = -1;
+static dev_t log_dev;
+static ino_t log_ino;
+
+static const char *log_map = NULL; // The file as of the last remap
+static size_t log_map_size = 0;
+
+static size_t *log_index = NULL;   // Offsets of records before log_base, newest first
+static int log_indexed = 0;
+static int log_index_cap = 0;
+static int log_index_complete = 0; // Walked back to the header
+static size_t log_base = 0;        // File end when the backward index was started
+
+static size_t *log_newer = NULL;   // Offsets of records after log_base, oldest first
+static int log_nnewer = 0;
+static int log_newer_cap = 0;
+static size_t log_read_end = 0;    // Everything before this offset is indexed
+
+static int retention = LOG_DEFAULT_RETENTION;
+static int appends_since_compact = 0;
+static char *last_command = NULL;  // For skipping repeated commands
+
+static void reopen_if_replaced(void);
 
 static void setup_log_filepath() {
     const char *home_dir  = NULL;
@@ -37,82 +97,468 @@ static void setup_log_filepath() {
     }
 }
 
+/* ---------------- FILE ACCESS ---------------- */
+
+static void unmap_log(void) {
+    if (log_map) munmap((void *)log_map, log_map_size);
+    log_map = NULL;
+    log_map_size = 0;
+}
+
+// Forgets every indexed record; the next lookup starts again from the end.
+static void reset_index(void) {
+    log_indexed = 0;
+    log_index_complete = 0;
+    log_nnewer = 0;
+    log_base = log_read_end = 0;
+}
+
+static int push_offset(size_t **array, int *count, int *cap, size_t offset) {
+    if (*count == *cap) {
+        int bigger_cap = *cap ? *cap * 2 : 32;
+        size_t *bigger = realloc(*array, bigger_cap * sizeof(size_t));
+        if (!bigger) {
+            perror("realloc");
+            return -1;
+        }
+        *array = bigger;
+        *cap = bigger_cap;
+    }
+    (*array)[(*count)++] = offset;
+    return 0;
+}
+
+static uint32_t read_u32(const char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Offset of the record that ends at end, or 0 if there is no valid one.
+static size_t record_before(size_t end) {
+    if (end < LOG_HEADER_SIZE + 2 * sizeof(uint32_t)) return 0;
+    uint32_t len = read_u32(log_map + end - sizeof(uint32_t));
+    if (len > end - LOG_HEADER_SIZE - 2 * sizeof(uint32_t)) return 0;
+    size_t start = end - len - 2 * sizeof(uint32_t);
+    if (read_u32(log_map + start) != len) return 0;
+    return start;
+}
+
+// Parses the records appended since the last look, by us or another shell.
+static void catch_up(void) {
+    // Nothing read yet, or the file was rewritten under us: index it from
+    // the end, lazily, like a fresh start.
+    if (log_read_end == 0 || (log_read_end > LOG_HEADER_SIZE && !record_before(log_read_end))) {
+        reset_index();
+        log_base = log_read_end = log_map_size;
+        return;
+    }
+    size_t pos = log_read_end;
+    while (pos + 2 * sizeof(uint32_t) <= log_map_size) {
+        uint32_t len = read_u32(log_map + pos);
+        size_t next = pos + len + 2 * sizeof(uint32_t);
+        if (next > log_map_size || read_u32(log_map + next - sizeof(uint32_t)) != len) break;
+        if (push_offset(&log_newer, &log_nnewer, &log_newer_cap, pos) < 0) break;
+        pos = next;
+    }
+    log_read_end = pos;
+
+    // With a retention window, the records before log_base eventually fall
+    // out of it; start afresh then so the offsets kept stay bounded.
+    if (retention > 0 && log_nnewer > 2 * retention) {
+        reset_index();
+        log_base = log_read_end = pos;
+    }
+}
+
+// Makes log_map cover the whole file and indexes what was appended to it.
+// Remapping is O(1) and the index survives it: the file only grows.
+static int remap_log(void) {
+    struct stat st;
+    if (log_fd < 0 || fstat(log_fd, &st) < 0) return -1;
+    if (log_map && (size_t)st.st_size == log_map_size) return 0;
+
+    unmap_log();
+    if ((size_t)st.st_size < log_read_end) reset_index(); // Purged by another shell
+    if (st.st_size <= LOG_HEADER_SIZE) return 0;
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, log_fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    log_map = map;
+    log_map_size = st.st_size;
+    catch_up();
+    return 0;
+}
+
+// Indexes records back from log_base until n are known in total or the
+// file is exhausted. Returns the number known.
+static int index_records(int n) {
+    while (log_nnewer + log_indexed < n && !log_index_complete) {
+        size_t end = log_indexed ? log_index[log_indexed - 1] : log_base;
+        size_t start = log_map ? record_before(end) : 0;
+        if (!start || push_offset(&log_index, &log_indexed, &log_index_cap, start) < 0) {
+            log_index_complete = 1;
+        }
+    }
+    return log_nnewer + log_indexed;
+}
+
+// Offset of the n-th newest record (0 = newest), or 0 if there is none.
+static size_t record_offset(int n) {
+    if (index_records(n + 1) <= n) return 0;
+    if (n < log_nnewer) return log_newer[log_nnewer - 1 - n];
+    return log_index[n - log_nnewer];
+}
+
+// Number of entries visible through the retention window, after catching
+// up with whatever other shells have done to the file.
+static int history_count(void) {
+    if (log_fd >= 0) reopen_if_replaced();
+    remap_log();
+    int known = index_records(retention > 0 ? retention : INT_MAX);
+    return retention > 0 && known > retention ? retention : known;
+}
+
+// The n-th newest entry (0 = newest), copied into the line arena.
+static char *history_entry(int n) {
+    size_t start = record_offset(n);
+    if (!start) return NULL;
+    return arena_strndup(&line_arena, log_map + start + sizeof(uint32_t),
+                         read_u32(log_map + start));
+}
+
+static void note_log_size(void) {
+    struct stat st;
+    if (log_fd >= 0 && fstat(log_fd, &st) == 0) metric_set(METRIC_HISTORY_BYTES, st.st_size);
+}
+
+static int open_log_file(void) {
+    int fd = open(log_filepath, O_RDWR | O_APPEND | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (log_fd >= 0) close(log_fd);
+    log_fd = fd;
+    log_dev = st.st_dev;
+    log_ino = st.st_ino;
+    unmap_log();
+    reset_index();
+    return 0;
+}
+
+// The file is only created once there is something to put in it. Another
+// shell may be creating it at the same time, so the header is written
+// under the lock and only into an empty file.
+static int create_log_file(void) {
+    int fd = open(log_filepath, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    close(fd);
+    if (open_log_file() < 0) return -1;
+
+    struct stat st;
+    flock(log_fd, LOCK_EX);
+    if (fstat(log_fd, &st) == 0 && st.st_size == 0 &&
+        write(log_fd, LOG_MAGIC, LOG_HEADER_SIZE) != LOG_HEADER_SIZE) {
+        perror("write");
+    }
+    flock(log_fd, LOCK_UN);
+    return 0;
+}
+
+// Follows a compaction done by another process (or our own child).
+static void reopen_if_replaced(void) {
+    struct stat st;
+    if (stat(log_filepath, &st) == 0 && (st.st_dev != log_dev || st.st_ino != log_ino)) {
+        open_log_file();
+    }
+}
+
+/* ---------------- COMPACTION ---------------- */
+
+// Writes header + the records from offset keep onwards to a temporary file
+// and renames it over the history. Runs with the exclusive lock held.
+static int rewrite_log(const char *data, size_t size, size_t keep) {
+    char tmp_path[1100];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", log_filepath, (int)getpid());
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    struct iovec iov[2] = {
+        { (void *)LOG_MAGIC, LOG_HEADER_SIZE },
+        { (void *)(data + keep), size - keep },
+    };
+    ssize_t want = LOG_HEADER_SIZE + (size - keep);
+    int ok = writev(fd, iov, 2) == want && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp_path, log_filepath) < 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static void compact_in_child(void) {
+    // flock() locks belong to the open file description, which this child
+    // shares with the shell; it needs its own to exclude the shell's appends.
+    if (open_log_file() < 0) _exit(0);
+    flock(log_fd, LOCK_EX);
+    reopen_if_replaced();
+    flock(log_fd, LOCK_EX);
+    // Work from a fresh view: other shells may have appended since.
+    if (remap_log() < 0 || !log_map) _exit(0);
+    size_t keep = record_offset(retention - 1);
+    if (!keep || keep == LOG_HEADER_SIZE) _exit(0);
+    rewrite_log(log_map, log_map_size, keep);
+    _exit(0);
+}
+
+// Starts a background compaction when records outside the retention window
+// take up more room than the visible ones. Checked at startup and then
+// once per retention appends, so the cost is amortised over the commands.
+static void maybe_compact(void) {
+    if (retention <= 0 || remap_log() < 0 || !log_map) return;
+    size_t keep = record_offset(retention - 1);
+    if (!keep) return;
+
+    size_t dead = keep - LOG_HEADER_SIZE;
+    size_t live = log_map_size - keep;
+    if (dead < LOG_COMPACT_MIN_BYTES || dead < live) return;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // The compactor is a grandchild, so check_jobs never reaps it and
+        // its CPU time cannot end up in a running `time`.
+        if (fork() == 0) compact_in_child();
+        _exit(0);
+    }
+    while (pid > 0 && waitpid(pid, NULL, 0) < 0 && errno == EINTR) {}
+}
+
+/* ---------------- STARTUP ---------------- */
+
+// Converts a history file in the old one-command-per-line text format.
+static void migrate_text_log(void) {
+    size_t size = 0;
+    lseek(log_fd, 0, SEEK_SET);
+    char *text = read_whole_fd(log_fd, &size, NULL);
+    if (!text) return;
+
+    size_t cap = LOG_HEADER_SIZE + size + 8 * (size + 1);
+    char *out = malloc(cap);
+    if (!out) {
+        free(text);
+        return;
+    }
+    memcpy(out, LOG_MAGIC, LOG_HEADER_SIZE);
+    size_t used = LOG_HEADER_SIZE;
+    char *p = text, *end = text + size;
+    while (p < end) {
+        char *nl = memchr(p, '\n', end - p);
+        uint32_t len = (nl ? nl : end) - p;
+        if (len > 0) {
+            memcpy(out + used, &len, sizeof(len));
+            memcpy(out + used + sizeof(len), p, len);
+            memcpy(out + used + sizeof(len) + len, &len, sizeof(len));
+            used += len + 2 * sizeof(len);
+        }
+        p += len + 1;
+    }
+
+    flock(log_fd, LOCK_EX);
+    if (rewrite_log(out, used, LOG_HEADER_SIZE) == 0) open_log_file();
+    free(out);
+    free(text);
+}
+
+// A crash in the middle of a write can leave a torn record at the end.
+// That is the only case that needs a forward scan: the file is cut back
+// to the last complete record.
+static void repair_tail(void) {
+    if (!log_map || record_before(log_map_size)) return;
+
+    size_t pos = LOG_HEADER_SIZE, good = LOG_HEADER_SIZE;
+    while (pos + sizeof(uint32_t) <= log_map_size) {
+        uint32_t len = read_u32(log_map + pos);
+        size_t next = pos + len + 2 * sizeof(uint32_t);
+        if (next > log_map_size || read_u32(log_map + next - sizeof(uint32_t)) != len) break;
+        pos = good = next;
+    }
+    flock(log_fd, LOCK_EX);
+    if (ftruncate(log_fd, good) < 0) perror("ftruncate");
+    flock(log_fd, LOCK_UN);
+    unmap_log();
+    reset_index();
+    remap_log();
+}
+
 void init_log() {
     setup_log_filepath();
-    FILE *log_file = fopen(log_filepath, "r");
-    if (!log_file) return;
 
-    char *line = NULL;
-    size_t len = 0;
-    while (getline(&line, &len, log_file) != -1 && history_count < MAX_HISTORY_SIZE) {
-        line[strcspn(line, "\n")] = 0; // Strip newline
-        command_history[history_count] = strdup(line);
-        history_count++;
+    const char *histsize = getenv("HISTSIZE");
+    if (histsize && *histsize) {
+        char *end;
+        long n = strtol(histsize, &end, 10);
+        if (*end == '\0' && n >= 0 && n <= INT_MAX) retention = (int)n;
+    }
+
+    if (open_log_file() < 0) return; // No history yet
+
+    char magic[LOG_HEADER_SIZE];
+    ssize_t n = pread(log_fd, magic, LOG_HEADER_SIZE, 0);
+    if (n == 0) {
+        create_log_file(); // Left empty by an older shell
+    } else if (n != LOG_HEADER_SIZE || memcmp(magic, LOG_MAGIC, LOG_HEADER_SIZE) != 0) {
+        migrate_text_log();
+    }
+
+    remap_log();
+    repair_tail();
+    if (history_count() > 0) {
+        char *newest = history_entry(0);
+        if (newest) last_command = strdup(newest);
     }
-    free(line);
-    fclose(log_file);
+    maybe_compact();
+    note_log_size();
 }
 
+/* ---------------- API ---------------- */
+
 void add_to_log(const char *command) {
     if (strncmp(command, "log", 3) == 0 && (command[3] == ' ' || command[3] == '\0')) {
         return;
     }
-    if (!command || !*command ||
-        (history_count > 0 && strcmp(command, command_history[history_count - 1]) == 0)) {
+    if (!command || !*command || (last_command && strcmp(command, last_command) == 0)) {
         return;
     }
-    if (history_count == MAX_HISTORY_SIZE) {
-        free(command_history[0]);
-        for (int i = 0; i < MAX_HISTORY_SIZE - 1; i++) {
-            command_history[i] = command_history[i + 1];
-        }
-        history_count--;
+    char *copy = strdup(command);
+    if (copy) {
+        free(last_command);
+        last_command = copy;
+    }
+    if (log_fd < 0 && create_log_file() < 0) return; // History is simply not kept.
+
+    // One write per command: the whole record goes out at once.
+    uint32_t len = strlen(command);
+    size_t size = len + 2 * sizeof(uint32_t);
+    char *record = arena_alloc(&line_arena, size);
+    if (!record) return;
+    memcpy(record, &len, sizeof(len));
+    memcpy(record + sizeof(len), command, len);
+    memcpy(record + sizeof(len) + len, &len, sizeof(len));
+
+    flock(log_fd, LOCK_SH);
+    reopen_if_replaced();
+    flock(log_fd, LOCK_SH);
+    if (write(log_fd, record, size) != (ssize_t)size) perror("Could not save command history");
+    flock(log_fd, LOCK_UN);
+    note_log_size();
+
+    if (retention > 0 && ++appends_since_compact >= retention) {
+        appends_since_compact = 0;
+        maybe_compact();
     }
-    command_history[history_count] = strdup(command);
-    history_count++;
 }
 
 void cleanup_log() {
-    FILE *log_file = fopen(log_filepath, "w");
-    if (!log_file) {
-        perror("Could not save command history");
-        return;
+    // Every command is already on disk; there is nothing left to save.
+    unmap_log();
+    reset_index();
+    free(log_index);
+    log_index = NULL;
+    log_index_cap = 0;
+    free(log_newer);
+    log_newer = NULL;
+    log_newer_cap = 0;
+    log_index_free();
+    free(last_command);
+    last_command = NULL;
+    if (log_fd >= 0) close(log_fd);
+    log_fd = -1;
+}
+
+// Searches every record still in the file, not just the retained window,
+// printing the best matches first (see log_index.c for the ranking).
+static int log_search(const char *pattern, int prefix) {
+    if (log_fd >= 0) {
+        reopen_if_replaced();
+        if (remap_log() < 0) return 1;
     }
-    for (int i = 0; i < history_count; i++) {
-        fprintf(log_file, "%s\n", command_history[i]);
-        free(command_history[i]);
+    log_index_sync(log_map, log_map_size, LOG_HEADER_SIZE, log_dev, log_ino);
+
+    LogMatch matches[LOG_SEARCH_RESULTS];
+    int found = log_index_search(pattern, prefix, matches, LOG_SEARCH_RESULTS);
+    for (int i = 0; i < found; i++) {
+        printf("%.*s\n", (int)matches[i].len, matches[i].text);
     }
-    fclose(log_file);
+    return 0;
 }
 
 int log_command(int argc, char **argv) {
     if (argc == 1) { // log
-        for (int i = 0; i < history_count; i++) {
-            printf("%s\n", command_history[i]);
+        int count = history_count();
+        for (int i = count - 1; i >= 0; i--) {
+            // NULL if the file lost the entry since it was counted
+            // (another session compacted or purged it) or out of memory.
+            char *entry = history_entry(i);
+            if (entry) printf("%s\n", entry);
         }
         return 0;
     }
 
     if (argc == 2 && strcmp(argv[1], "purge") == 0) { // log purge
-        for (int i = 0; i < history_count; i++) {
-            free(command_history[i]);
-            command_history[i] = NULL;
+        free(last_command);
+        last_command = NULL;
+        if (log_fd >= 0) {
+            flock(log_fd, LOCK_EX);
+            reopen_if_replaced();
+            flock(log_fd, LOCK_EX);
+            if (ftruncate(log_fd, LOG_HEADER_SIZE) < 0) perror("log purge");
+            flock(log_fd, LOCK_UN);
+            unmap_log();
+            reset_index();
+            log_index_free();
         }
-        history_count = 0;
-        remove(log_filepath);
         return 0;
     }
 
+    if (argc >= 3 && strcmp(argv[1], "search") == 0) { // log search [-p] <pattern...>
+        int first = 2, prefix = 0;
+        if (strcmp(argv[2], "-p") == 0) {
+            prefix = 1;
+            first = 3;
+        }
+        if (first >= argc) {
+            printf("Usage: log search [-p] <pattern>\n");
+            return 1;
+        }
+        // The words of the pattern are matched as typed, one space apart.
+        size_t len = 0;
+        for (int i = first; i < argc; i++) len += strlen(argv[i]) + 1;
+        char *pattern = arena_alloc(&line_arena, len);
+        if (!pattern) return 1;
+        pattern[0] = '\0';
+        for (int i = first; i < argc; i++) {
+            if (i > first) strcat(pattern, " ");
+            strcat(pattern, argv[i]);
+        }
+        return log_search(pattern, prefix);
+    }
+
     if (argc == 3 && strcmp(argv[1], "execute") == 0) { // log execute <index>
         int index = atoi(argv[2]);
-        if (index < 1 || index > history_count) {
+        if (index < 1 || index > history_count()) {
             printf("Invalid index!\n");
             return 1;
         }
 
-        int real_index = history_count - index;
-        char *cmd_to_run = command_history[real_index];
-        
+        char *cmd_to_run = history_entry(index - 1);
+        if (!cmd_to_run) return 1;
         execute_cmd(cmd_to_run, 0);
         return 0;
     }
@@ -121,7 +567,8 @@ int log_command(int argc, char **argv) {
     return 1;
 }
 
-char* replace_log_execute(const char* command) {
+// Expansion results live in the line arena, so nothing here is freed.
+static char* replace_log_execute(const char* command) {
     const char* pattern = "log execute ";
     char* occurrence = strstr(command, pattern);
 
@@ -131,13 +578,6 @@ char* replace_log_execute(const char* command) {
 
     // Isolate the part of the string before "log execute"
     size_t prefix_len = occurrence - command;
-    char* prefix = (char*)malloc(prefix_len + 1);
-    if (!prefix) {
-        perror("malloc");
-        return NULL;
-    }
-    strncpy(prefix, command, prefix_len);
-    prefix[prefix_len] = '\0';
 
     // Parse the index
     char* index_start = occurrence + strlen(pattern);
@@ -145,14 +585,16 @@ char* replace_log_execute(const char* command) {
     long index = strtol(index_start, &index_end, 10);
 
     // Validate the index
-    if (index_start == index_end || index < 1 || index > history_count) {
+    if (index_start == index_end || index < 1 || index > history_count()) {
         fprintf(stderr, "Error: Invalid log index.\n");
-        free(prefix);
         return NULL; // Stop processing on invalid index
     }
 
     // Get the command from history (1-based index from most recent)
-    const char* history_cmd = command_history[history_count - index];
+    const char* history_cmd = history_entry(index - 1);
+    if (!history_cmd) {
+        return NULL;
+    }
 
     // Skip leading whitespace in the rest of the string
     while (isspace((unsigned char)*index_end)) {
@@ -160,43 +602,34 @@ char* replace_log_execute(const char* command) {
     }
     const char* suffix = index_end;
 
-    // Allocate memory for the new command string
-    size_t new_len = strlen(prefix) + strlen(history_cmd) + strlen(suffix) + 1;
-    char* new_command = (char*)malloc(new_len);
+    // Construct the new command
+    size_t history_len = strlen(history_cmd);
+    size_t suffix_len = strlen(suffix);
+    char* new_command = arena_alloc(&line_arena, prefix_len + history_len + suffix_len + 1);
     if (!new_command) {
-        perror("malloc");
-        free(prefix);
         return NULL;
     }
+    memcpy(new_command, command, prefix_len);
+    memcpy(new_command + prefix_len, history_cmd, history_len);
+    memcpy(new_command + prefix_len + history_len, suffix, suffix_len + 1);
 
-    // Construct the new command
-    snprintf(new_command, new_len, "%s%s%s", prefix, history_cmd, suffix);
-
-    free(prefix);
     return new_command;
 }
 
-char* process_log_execute(const char* command) {
-    char* current_command = strdup(command);
-    if (!current_command) {
-        perror("strdup");
-        return NULL;
-    }
-
+const char* process_log_execute(const char* command) {
+    const char* current_command = command;
     char* next_command;
     int replacements = 0;
     const int MAX_REPLACEMENTS = 10; // Safeguard against infinite loops
 
     while ((next_command = replace_log_execute(current_command)) != NULL) {
-        free(current_command);
         current_command = next_command;
         replacements++;
         if (replacements > MAX_REPLACEMENTS) {
             fprintf(stderr, "Error: Exceeded maximum log execute replacements, possible infinite loop\n");
-            free(current_command);
             return NULL;
         }
     }
 
     return current_command;
-}
\ No newline at end of file
+}
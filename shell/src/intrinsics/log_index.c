@@ -0,0 +1,327 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intrinsics/log_index.h"
+
+/*
+Search index over the history file. Repeated commands are folded into one
+entry that counts how often, and how recently, the command was run. Each
+distinct command is listed under every trigram (three-byte window) of its
+text, so a query only has to check the commands filed under the query's
+rarest trigram instead of the whole history. Patterns shorter than three
+bytes fall back to a scan of the distinct commands.
+
+The file is append-only, so keeping up with it means reading the records
+past indexed_end. Compaction replaces the file and purge shrinks it; both
+are noticed from (dev, ino) and the size, and cause a rebuild. A purge by
+another session followed by enough new commands leaves the file longer than
+before, so the last record indexed must also still be in place, ending at
+indexed_end with the same text, before indexing resumes there.
+
+Matches are ranked by frequency, discounted by how many commands ago they
+were last used: count / (1 + age / RECENCY_SCALE).
+*/
+
+#define RECENCY_SCALE 100.0
+
+typedef struct {
+    size_t offset;       // Latest record holding this command
+    uint32_t len;
+    uint32_t count;
+    uint32_t last_seq;   // Sequence number of the latest use
+    uint32_t hash;
+} Entry;
+
+typedef struct {
+    uint32_t key;        // Trigram + 1, 0 = empty slot
+    uint32_t len;
+    uint32_t cap;
+    uint32_t *ids;       // Entries containing the trigram, ascending
+} Posting;
+
+static const char *map_base = NULL;
+static size_t indexed_end = 0;
+static size_t last_offset = 0;     // Last record indexed, 0 if none
+static uint32_t last_hash;
+static dev_t index_dev;
+static ino_t index_ino;
+static uint32_t next_seq = 0;
+
+static Entry *entries = NULL;
+static uint32_t nentries = 0, entries_cap = 0;
+
+static uint32_t *by_text = NULL;   // Open addressing: entry id + 1
+static size_t by_text_cap = 0;
+
+static Posting *postings = NULL;   // Open addressing by trigram
+static size_t postings_cap = 0, npostings = 0;
+
+static uint32_t hash_bytes(const char *s, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static uint32_t trigram_at(const char *s) {
+    return ((uint32_t)(unsigned char)s[0] << 16) | ((uint32_t)(unsigned char)s[1] << 8) |
+           (unsigned char)s[2];
+}
+
+static const char *entry_text(const Entry *e) {
+    return map_base + e->offset + sizeof(uint32_t);
+}
+
+/* ---------------- TABLES ---------------- */
+
+static int grow_by_text(void) {
+    size_t cap = by_text_cap ? by_text_cap * 2 : 1024;
+    uint32_t *table = calloc(cap, sizeof(uint32_t));
+    if (!table) return -1;
+    for (uint32_t id = 0; id < nentries; id++) {
+        size_t i = entries[id].hash & (cap - 1);
+        while (table[i]) i = (i + 1) & (cap - 1);
+        table[i] = id + 1;
+    }
+    free(by_text);
+    by_text = table;
+    by_text_cap = cap;
+    return 0;
+}
+
+static Posting *find_posting(uint32_t trigram) {
+    if (!postings_cap) return NULL;
+    size_t i = (trigram * 2654435761u) & (postings_cap - 1);
+    while (postings[i].key) {
+        if (postings[i].key == trigram + 1) return &postings[i];
+        i = (i + 1) & (postings_cap - 1);
+    }
+    return NULL;
+}
+
+static int grow_postings(void) {
+    size_t cap = postings_cap ? postings_cap * 2 : 4096;
+    Posting *table = calloc(cap, sizeof(Posting));
+    if (!table) return -1;
+    for (size_t j = 0; j < postings_cap; j++) {
+        if (!postings[j].key) continue;
+        size_t i = ((postings[j].key - 1) * 2654435761u) & (cap - 1);
+        while (table[i].key) i = (i + 1) & (cap - 1);
+        table[i] = postings[j];
+    }
+    free(postings);
+    postings = table;
+    postings_cap = cap;
+    return 0;
+}
+
+static int add_posting(uint32_t trigram, uint32_t id) {
+    Posting *p = find_posting(trigram);
+    if (!p) {
+        if ((npostings + 1) * 4 > postings_cap * 3 && grow_postings() < 0) return -1;
+        size_t i = (trigram * 2654435761u) & (postings_cap - 1);
+        while (postings[i].key) i = (i + 1) & (postings_cap - 1);
+        p = &postings[i];
+        p->key = trigram + 1;
+        npostings++;
+    }
+    if (p->len && p->ids[p->len - 1] == id) return 0; // Trigram repeats in the text
+    if (p->len == p->cap) {
+        uint32_t cap = p->cap ? p->cap * 2 : 4;
+        uint32_t *ids = realloc(p->ids, cap * sizeof(uint32_t));
+        if (!ids) return -1;
+        p->ids = ids;
+        p->cap = cap;
+    }
+    p->ids[p->len++] = id;
+    return 0;
+}
+
+// Folds the record at offset, whose text hashes to h, into the index.
+static int index_record(size_t offset, const char *text, uint32_t len, uint32_t h) {
+    uint32_t seq = next_seq++;
+
+    if (by_text_cap) {
+        size_t i = h & (by_text_cap - 1);
+        while (by_text[i]) {
+            Entry *e = &entries[by_text[i] - 1];
+            if (e->hash == h && e->len == len && memcmp(entry_text(e), text, len) == 0) {
+                e->offset = offset;
+                e->count++;
+                e->last_seq = seq;
+                return 0;
+            }
+            i = (i + 1) & (by_text_cap - 1);
+        }
+    }
+
+    if (nentries == entries_cap) {
+        uint32_t cap = entries_cap ? entries_cap * 2 : 1024;
+        Entry *bigger = realloc(entries, cap * sizeof(Entry));
+        if (!bigger) return -1;
+        entries = bigger;
+        entries_cap = cap;
+    }
+    if ((nentries + 1) * 2 > by_text_cap && grow_by_text() < 0) return -1;
+
+    uint32_t id = nentries++;
+    entries[id] = (Entry){ offset, len, 1, seq, h };
+    size_t i = h & (by_text_cap - 1);
+    while (by_text[i]) i = (i + 1) & (by_text_cap - 1);
+    by_text[i] = id + 1;
+
+    for (uint32_t k = 0; k + 3 <= len; k++) {
+        if (add_posting(trigram_at(text + k), id) < 0) return -1;
+    }
+    return 0;
+}
+
+void log_index_free(void) {
+    for (size_t i = 0; i < postings_cap; i++) free(postings[i].ids);
+    free(postings);
+    free(by_text);
+    free(entries);
+    postings = NULL;
+    by_text = NULL;
+    entries = NULL;
+    postings_cap = npostings = by_text_cap = 0;
+    nentries = entries_cap = 0;
+    indexed_end = 0;
+    last_offset = 0;
+    next_seq = 0;
+}
+
+// Whether the last record indexed is still the one ending at indexed_end.
+static int last_record_intact(const char *map) {
+    if (!last_offset) return 1;
+    uint32_t len;
+    memcpy(&len, map + last_offset, sizeof(len));
+    return last_offset + len + 2 * sizeof(uint32_t) == indexed_end &&
+           hash_bytes(map + last_offset + sizeof(uint32_t), len) == last_hash;
+}
+
+void log_index_sync(const char *map, size_t size, size_t data_start, dev_t dev, ino_t ino) {
+    if (indexed_end && (dev != index_dev || ino != index_ino || size < indexed_end ||
+                        (map && !last_record_intact(map)))) {
+        log_index_free();
+    }
+    index_dev = dev;
+    index_ino = ino;
+    map_base = map;
+    if (!map) return;
+    if (indexed_end < data_start) indexed_end = data_start;
+
+    size_t pos = indexed_end;
+    while (pos + 2 * sizeof(uint32_t) <= size) {
+        uint32_t len, tail;
+        memcpy(&len, map + pos, sizeof(len));
+        size_t next = pos + len + 2 * sizeof(uint32_t);
+        if (next > size) break;
+        memcpy(&tail, map + next - sizeof(tail), sizeof(tail));
+        if (tail != len) break; // Torn record being written
+        uint32_t h = hash_bytes(map + pos + sizeof(uint32_t), len);
+        if (index_record(pos, map + pos + sizeof(uint32_t), len, h) < 0) {
+            perror("log search");
+            break;
+        }
+        last_offset = pos;
+        last_hash = h;
+        pos = next;
+    }
+    indexed_end = pos;
+}
+
+/* ---------------- QUERIES ---------------- */
+
+static double score(const Entry *e) {
+    double age = next_seq - 1 - e->last_seq;
+    return e->count / (1.0 + age / RECENCY_SCALE);
+}
+
+// True if a ranks above b.
+static int better(const Entry *a, const Entry *b) {
+    double sa = score(a), sb = score(b);
+    if (sa != sb) return sa > sb;
+    return a->last_seq > b->last_seq;
+}
+
+// heap[0] is the weakest of the best `size` matches so far.
+static void sift_down(const Entry **heap, int size, int i) {
+    while (1) {
+        int weakest = i, l = 2 * i + 1, r = l + 1;
+        if (l < size && better(heap[weakest], heap[l])) weakest = l;
+        if (r < size && better(heap[weakest], heap[r])) weakest = r;
+        if (weakest == i) return;
+        const Entry *tmp = heap[i];
+        heap[i] = heap[weakest];
+        heap[weakest] = tmp;
+        i = weakest;
+    }
+}
+
+static void offer(const Entry **heap, int *size, int limit, const Entry *e) {
+    if (*size < limit) {
+        int i = (*size)++;
+        heap[i] = e;
+        while (i > 0 && better(heap[(i - 1) / 2], heap[i])) {
+            const Entry *tmp = heap[i];
+            heap[i] = heap[(i - 1) / 2];
+            heap[(i - 1) / 2] = tmp;
+            i = (i - 1) / 2;
+        }
+    } else if (better(e, heap[0])) {
+        heap[0] = e;
+        sift_down(heap, *size, 0);
+    }
+}
+
+static int matches(const Entry *e, const char *pattern, size_t plen, int prefix) {
+    if (e->len < plen) return 0;
+    if (prefix) return memcmp(entry_text(e), pattern, plen) == 0;
+    return memmem(entry_text(e), e->len, pattern, plen) != NULL;
+}
+
+int log_index_search(const char *pattern, int prefix, LogMatch *out, int limit) {
+    size_t plen = strlen(pattern);
+    if (limit <= 0 || !map_base) return 0;
+
+    const Entry **heap = malloc(limit * sizeof(Entry *));
+    if (!heap) return 0;
+    int found = 0;
+
+    // Candidates come from the query's rarest trigram; if one of them does
+    // not occur at all, nothing can match.
+    const Posting *rarest = NULL;
+    int no_match = 0;
+    for (size_t k = 0; k + 3 <= plen; k++) {
+        const Posting *p = find_posting(trigram_at(pattern + k));
+        if (!p) {
+            no_match = 1;
+            break;
+        }
+        if (!rarest || p->len < rarest->len) rarest = p;
+    }
+
+    if (no_match) {
+        // Nothing to do
+    } else if (rarest) {
+        for (uint32_t j = 0; j < rarest->len; j++) {
+            const Entry *e = &entries[rarest->ids[j]];
+            if (matches(e, pattern, plen, prefix)) offer(heap, &found, limit, e);
+        }
+    } else {
+        for (uint32_t id = 0; id < nentries; id++) {
+            if (matches(&entries[id], pattern, plen, prefix)) offer(heap, &found, limit, &entries[id]);
+        }
+    }
+
+    // Pop the heap weakest first to fill the results from the back.
+    for (int n = found; n > 0; n--) {
+        const Entry *e = heap[0];
+        out[n - 1] = (LogMatch){ entry_text(e), e->len, e->count };
+        heap[0] = heap[n - 1];
+        sift_down(heap, n - 1, 0);
+    }
+    free(heap);
+    return found;
+}
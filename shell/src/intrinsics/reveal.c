@@ -1,24 +1,210 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include "intrinsics/hop.h"
 #include "intrinsics/reveal.h"
+#include "intrinsics/reveal_long.h"
+#include "intrinsics/reveal_tree.h"
+#include "intrinsics/dircache.h"
+#include "arena.h"
 
-// Helper: qsort comparator
-static int cmpstr(const void *a, const void *b) {
-    const char *sa = *(const char **)a;
-    const char *sb = *(const char **)b;
-    return strcmp(sa, sb);  // ASCII lexicographic order
+/*
+Listing engine, built for directories with millions of entries:
+
+- Entries are read with getdents64 into one large buffer, so a directory
+  costs a few syscalls rather than one readdir refill per 32KB.
+- Names are packed back to back into blocks of a private arena; each
+  costs its length + 2 (the d_type byte sits just before it) plus one
+  pointer, with no per-name malloc. A NameList can be reset and reused,
+  keeping its blocks and buffer, which the -R walker does per directory.
+- The pointers are sorted in place by an MSD radix sort (American flag
+  sort) on the bytes of the names, which gives strcmp order without
+  calling strcmp for every comparison. Small buckets use insertion sort.
+- The output is written straight from the name blocks with writev, a
+  name and its separator per pair of iovecs, so nothing is copied again.
+- Listings come through the directory cache (dircache.c), so revealing
+  an unchanged directory again costs an fstat and no getdents at all.
+
+-l keeps the one-name-per-line layout; -L is the ls -l style long format,
+and -S / -t order by size / modification time (see reveal_long.c). -R
+walks the tree on several threads (see reveal_tree.c).
+*/
+
+#define DIRENT_BUF_SIZE (256 * 1024)
+#define NAME_BLOCK_MIN 4096
+#define NAME_BLOCK_SIZE (256 * 1024)
+#define INSERTION_CUTOFF 32
+
+static int add_name(NameList *list, const char *name, unsigned char type) {
+    size_t size = strlen(name) + 2;
+    if (size > list->block_room) {
+        // Blocks grow with the list, so a small directory stays small.
+        size_t block_size = arena_stats(&list->arena)->reserved;
+        if (block_size < NAME_BLOCK_MIN) block_size = NAME_BLOCK_MIN;
+        if (block_size > NAME_BLOCK_SIZE) block_size = NAME_BLOCK_SIZE;
+        if (block_size < size) block_size = size;
+        list->block = arena_alloc(&list->arena, block_size);
+        if (!list->block) return -1;
+        list->block_room = block_size;
+    }
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        char **bigger = realloc(list->names, cap * sizeof(char *));
+        if (!bigger) {
+            perror("realloc");
+            return -1;
+        }
+        list->names = bigger;
+        list->cap = cap;
+    }
+    list->block[0] = type;
+    memcpy(list->block + 1, name, size - 1);
+    list->names[list->count++] = list->block + 1;
+    list->block += size;
+    list->block_room -= size;
+    return 0;
+}
+
+void reset_names(NameList *list) {
+    arena_reset(&list->arena);
+    list->block = NULL;
+    list->block_room = 0;
+    list->count = 0;
+}
+
+void free_names(NameList *list) {
+    arena_destroy(&list->arena);
+    free(list->names);
+    free(list->dirent_buf);
+}
+
+int read_names(int fd, int show_all, NameList *list) {
+    if (!list->dirent_buf && !(list->dirent_buf = malloc(DIRENT_BUF_SIZE))) {
+        perror("malloc");
+        return -1;
+    }
+    char *buf = list->dirent_buf;
+    ssize_t n;
+    while ((n = getdents64(fd, buf, DIRENT_BUF_SIZE)) > 0) {
+        for (ssize_t pos = 0; pos < n;) {
+            struct dirent64 *d = (struct dirent64 *)(buf + pos);
+            pos += d->d_reclen;
+            if (!show_all && d->d_name[0] == '.') continue;
+            if (add_name(list, d->d_name, d->d_type) < 0) return -1;
+        }
+    }
+    return n < 0 ? -1 : 0;
+}
+
+/* ---------------- SORTING ---------------- */
+
+static void insertion_sort(char **a, size_t n, size_t depth) {
+    for (size_t i = 1; i < n; i++) {
+        char *v = a[i];
+        size_t j = i;
+        while (j > 0 && strcmp(a[j - 1] + depth, v + depth) > 0) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = v;
+    }
+}
+
+// Sorts names that share their first depth bytes, by byte value from
+// there on: the same order as strcmp, i.e. ASCII lexicographic.
+void radix_sort(char **a, size_t n, size_t depth) {
+    if (n < INSERTION_CUTOFF) {
+        insertion_sort(a, n, depth);
+        return;
+    }
+
+    size_t count[256] = {0};
+    for (size_t i = 0; i < n; i++) count[(unsigned char)a[i][depth]]++;
+
+    // next[c] is where the next name with byte c goes; permute in place by
+    // following each misplaced name to its bucket.
+    size_t next[256], end[256];
+    size_t sum = 0;
+    for (int c = 0; c < 256; c++) {
+        next[c] = sum;
+        sum += count[c];
+        end[c] = sum;
+    }
+    for (int c = 0; c < 256; c++) {
+        while (next[c] < end[c]) {
+            char *v = a[next[c]];
+            unsigned char b = v[depth];
+            while (b != c) {
+                char *displaced = a[next[b]];
+                a[next[b]++] = v;
+                v = displaced;
+                b = v[depth];
+            }
+            a[next[c]++] = v;
+        }
+    }
+
+    // Bucket 0 holds names that ended here, which are all equal.
+    size_t start = count[0];
+    for (int c = 1; c < 256; c++) {
+        if (count[c] > 1) radix_sort(a + start, count[c], depth + 1);
+        start += count[c];
+    }
+}
+
+/* ---------------- OUTPUT ---------------- */
+
+// Writes the names, each followed by sep and the last by a newline, in
+// batches of IOV_MAX / 2 names per writev. The names are left untouched.
+static int write_names(char **names, size_t count, char sep) {
+    struct iovec iov[IOV_MAX];
+    char seps[2] = { sep, '\n' };
+    fflush(stdout); // Anything printed earlier goes first.
+
+    for (size_t i = 0; i < count;) {
+        int niov = 0;
+        for (; i < count && niov + 2 <= IOV_MAX; i++) {
+            iov[niov++] = (struct iovec){ names[i], strlen(names[i]) };
+            iov[niov++] = (struct iovec){ &seps[i == count - 1], 1 };
+        }
+
+        struct iovec *cur = iov;
+        while (niov > 0) {
+            ssize_t n = writev(STDOUT_FILENO, cur, niov);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                perror("reveal");
+                return -1;
+            }
+            // Skip what was written; a short write resumes mid-iovec.
+            while (niov > 0 && (size_t)n >= cur->iov_len) {
+                n -= cur->iov_len;
+                cur++;
+                niov--;
+            }
+            if (niov > 0) {
+                cur->iov_base = (char *)cur->iov_base + n;
+                cur->iov_len -= n;
+            }
+        }
+    }
+    return 0;
 }
 
 int reveal_command(int argc, char **argv) {
     int show_all = 0;   // -a
     int long_list = 0;  // -l
+    int long_format = 0; // -L
+    char sort_key = 0;  // -S or -t
+    int recursive = 0;  // -R
     char *target_dir = NULL;
 
     int seen_path = 0;  // have we already consumed the (~ | . | .. | - | name) part?
@@ -42,6 +228,9 @@ int reveal_command(int argc, char **argv) {
             for (int j = 1; arg[j] != '\0'; j++) {
                 if (arg[j] == 'a') show_all = 1;
                 else if (arg[j] == 'l') long_list = 1;
+                else if (arg[j] == 'L') long_format = 1;
+                else if (arg[j] == 'S' || arg[j] == 't') sort_key = arg[j];
+                else if (arg[j] == 'R') recursive = 1;
                 else {
                     printf("reveal: Invalid flag -%c\n", arg[j]);
                     return 0;
@@ -76,50 +265,60 @@ int reveal_command(int argc, char **argv) {
     }
 
 
+    if (recursive) {
+        struct stat st;
+        if (stat(target_dir, &st) < 0 || !S_ISDIR(st.st_mode)) {
+            printf("No such directory!\n");
+            free(target_dir);
+            return 0;
+        }
+        int result = reveal_tree(target_dir, show_all, long_format ? 'L' : long_list ? 'l' : 0,
+                                 sort_key);
+        free(target_dir);
+        return result;
+    }
+
     // --- Open directory ---
-    DIR *dir = opendir(target_dir);
-    if (!dir) {
+    int fd = open(target_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(target_dir);
+    if (fd < 0) {
         printf("No such directory!\n");
-        free(target_dir);
         return 0;
     }
 
-    // --- Collect entries ---
-    struct dirent *entry;
-    char **entries = NULL;
-    size_t count = 0;
-
-    while ((entry = readdir(dir)) != NULL) {
-        // skip hidden unless -a
-        if (!show_all && entry->d_name[0] == '.') continue;
-
-        entries = realloc(entries, sizeof(char *) * (count + 1));
-        if (!entries) {
-            perror("realloc");
-            closedir(dir);
-            free(target_dir);
-            return 1;
-        }
-        entries[count++] = strdup(entry->d_name);
+    CachedDir *dir = dircache_get(fd);
+    if (!dir) {
+        perror("reveal");
+        close(fd);
+        return 1;
     }
-    closedir(dir);
 
-    // --- Sort ---
-    qsort(entries, count, sizeof(char *), cmpstr);
+    // The cached listing is shared, so the visible names are picked out
+    // into an array of our own.
+    size_t total, count = 0;
+    char *const *all = dircache_names(dir, &total);
+    char **names = malloc((total ? total : 1) * sizeof(char *));
+    int ok = names != NULL;
+    for (size_t i = 0; ok && i < total; i++) {
+        if (show_all || all[i][0] != '.') names[count++] = all[i];
+    }
 
-    // --- Print ---
-    for (size_t i = 0; i < count; i++) {
-        printf("%s", entries[i]);
-        if (long_list) {
-            printf("\n");
-        } else {
-            if (i < count - 1) printf(" ");
+    if (ok && (long_format || sort_key)) {
+        FileInfo *info = stat_names(fd, names, count);
+        ok = info != NULL;
+        if (ok && sort_key) sort_by_info(info, count, sort_key == 't');
+        if (ok && long_format) {
+            ok = write_long(fd, info, count) == 0;
+        } else if (ok) {
+            for (size_t i = 0; i < count; i++) names[i] = info[i].name;
+            ok = write_names(names, count, long_list ? '\n' : ' ') == 0;
         }
-        free(entries[i]);
+        free(info);
+    } else if (ok) {
+        ok = write_names(names, count, long_list ? '\n' : ' ') == 0;
     }
-    if (!long_list && count > 0) printf("\n");
-
-    free(entries);
-    free(target_dir);
-    return 0;
+    free(names);
+    dircache_release(dir);
+    close(fd);
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,342 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <grp.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "intrinsics/reveal_long.h"
+
+/*
+Long listings for reveal. Every entry needs an fstatat() relative to the
+open directory, which on a large or cold directory is mostly waiting on
+the filesystem; the names are split across a few threads so those waits
+overlap. (io_uring's IORING_OP_STATX would be handed to kernel worker
+threads the same way, so it is not worth its setup here.) Small listings
+are stat'ed inline.
+
+Owner and group names are looked up once per distinct id per listing.
+*/
+
+#define STAT_THREADS 8
+#define STAT_INLINE_MAX 512   // Fewer entries than this are stat'ed inline
+#define OUT_BUF_SIZE (64 * 1024)
+#define SIX_MONTHS (183L * 24 * 60 * 60)
+
+/* ---------------- METADATA ---------------- */
+
+typedef struct {
+    int dir_fd;
+    char **names;
+    FileInfo *info;
+    size_t start;
+    size_t end;
+} StatSlice;
+
+static void *stat_slice(void *arg) {
+    StatSlice *slice = arg;
+    for (size_t i = slice->start; i < slice->end; i++) {
+        FileInfo *fi = &slice->info[i];
+        struct stat st;
+        fi->name = slice->names[i];
+        fi->ok = fstatat(slice->dir_fd, fi->name, &st, AT_SYMLINK_NOFOLLOW) == 0;
+        if (!fi->ok) continue;
+        fi->mode = st.st_mode;
+        fi->nlink = st.st_nlink;
+        fi->uid = st.st_uid;
+        fi->gid = st.st_gid;
+        fi->size = st.st_size;
+        fi->blocks = st.st_blocks;
+        fi->mtime = st.st_mtim;
+    }
+    return NULL;
+}
+
+FileInfo *stat_names(int dir_fd, char **names, size_t count) {
+    FileInfo *info = calloc(count ? count : 1, sizeof(FileInfo));
+    if (!info) {
+        perror("calloc");
+        return NULL;
+    }
+
+    StatSlice slices[STAT_THREADS];
+    pthread_t threads[STAT_THREADS];
+    int nthreads = count < STAT_INLINE_MAX ? 1 : STAT_THREADS;
+    int started = 0;
+
+    for (int t = 0; t < nthreads; t++) {
+        slices[t] = (StatSlice){ dir_fd, names, info, count * t / nthreads,
+                                 count * (t + 1) / nthreads };
+    }
+    // Slice 0 runs on this thread; if a thread cannot be created, its
+    // slice is done here too.
+    for (int t = 1; t < nthreads; t++) {
+        if (pthread_create(&threads[t], NULL, stat_slice, &slices[t]) != 0) break;
+        started = t;
+    }
+    stat_slice(&slices[0]);
+    for (int t = started + 1; t < nthreads; t++) stat_slice(&slices[t]);
+    for (int t = 1; t <= started; t++) pthread_join(threads[t], NULL);
+    return info;
+}
+
+static int by_size(const void *a, const void *b) {
+    const FileInfo *fa = a, *fb = b;
+    if (fa->size != fb->size) return fa->size < fb->size ? 1 : -1;
+    return strcmp(fa->name, fb->name);
+}
+
+static int by_time(const void *a, const void *b) {
+    const FileInfo *fa = a, *fb = b;
+    if (fa->mtime.tv_sec != fb->mtime.tv_sec) return fa->mtime.tv_sec < fb->mtime.tv_sec ? 1 : -1;
+    if (fa->mtime.tv_nsec != fb->mtime.tv_nsec) return fa->mtime.tv_nsec < fb->mtime.tv_nsec ? 1 : -1;
+    return strcmp(fa->name, fb->name);
+}
+
+void sort_by_info(FileInfo *info, size_t count, int by_mtime) {
+    qsort(info, count, sizeof(FileInfo), by_mtime ? by_time : by_size);
+}
+
+/* ---------------- OWNERS ---------------- */
+
+typedef struct {
+    unsigned id;
+    char name[64];
+} IdName;
+
+typedef struct {
+    IdName *entries;
+    size_t count;
+    size_t cap;
+    size_t last;         // Most recent hit; listings tend to repeat an id
+} IdCache;
+
+// Copies the user (or group) name for id into name. The reentrant lookups
+// are needed because reveal -RL formats listings on several threads.
+static int lookup_name(unsigned id, int is_group, char *name, size_t size) {
+    size_t buf_size = 1024;
+    char *buf = NULL;
+    int found = 0;
+    while (1) {
+        char *bigger = realloc(buf, buf_size);
+        if (!bigger) break;
+        buf = bigger;
+        const char *result = NULL;
+        int err;
+        if (is_group) {
+            struct group gr, *match;
+            err = getgrgid_r(id, &gr, buf, buf_size, &match);
+            if (!err && match) result = gr.gr_name;
+        } else {
+            struct passwd pw, *match;
+            err = getpwuid_r(id, &pw, buf, buf_size, &match);
+            if (!err && match) result = pw.pw_name;
+        }
+        // Large groups list every member, so the buffer may need to grow.
+        if (err == ERANGE && buf_size < (1 << 20)) {
+            buf_size *= 2;
+            continue;
+        }
+        if (result) {
+            snprintf(name, size, "%s", result);
+            found = 1;
+        }
+        break;
+    }
+    free(buf);
+    return found;
+}
+
+static const char *cached_name(IdCache *cache, unsigned id, int is_group) {
+    if (cache->count && cache->entries[cache->last].id == id) return cache->entries[cache->last].name;
+    for (size_t i = 0; i < cache->count; i++) {
+        if (cache->entries[i].id == id) {
+            cache->last = i;
+            return cache->entries[i].name;
+        }
+    }
+
+    if (cache->count == cache->cap) {
+        size_t cap = cache->cap ? cache->cap * 2 : 8;
+        IdName *bigger = realloc(cache->entries, cap * sizeof(IdName));
+        if (!bigger) return "?";
+        cache->entries = bigger;
+        cache->cap = cap;
+    }
+    IdName *e = &cache->entries[cache->count];
+    e->id = id;
+    if (!lookup_name(id, is_group, e->name, sizeof(e->name))) {
+        snprintf(e->name, sizeof(e->name), "%u", id);
+    }
+    cache->last = cache->count++;
+    return e->name;
+}
+
+/* ---------------- OUTPUT ---------------- */
+
+void out_init(OutBuf *out, int fd) {
+    out->data = NULL;
+    out->used = out->cap = 0;
+    out->fd = fd;
+    out->failed = 0;
+}
+
+static void flush_out(OutBuf *out) {
+    size_t done = 0;
+    while (!out->failed && done < out->used) {
+        ssize_t n = write(out->fd, out->data + done, out->used - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("reveal");
+            out->failed = 1;
+        } else {
+            done += n;
+        }
+    }
+    out->used = 0;
+}
+
+// Makes room for at least n more bytes, by flushing or by growing.
+static int out_reserve(OutBuf *out, size_t n) {
+    if (out->cap - out->used >= n) return 0;
+    if (out->fd >= 0 && out->cap >= n) {
+        flush_out(out);
+        return 0;
+    }
+    size_t cap = out->cap ? out->cap : OUT_BUF_SIZE;
+    while (cap - out->used < n) cap *= 2;
+    char *bigger = realloc(out->data, cap);
+    if (!bigger) {
+        perror("realloc");
+        out->failed = 1;
+        return -1;
+    }
+    out->data = bigger;
+    out->cap = cap;
+    return 0;
+}
+
+void out_append(OutBuf *out, const char *s, size_t n) {
+    if (out_reserve(out, n) < 0) return;
+    memcpy(out->data + out->used, s, n);
+    out->used += n;
+}
+
+void out_printf(OutBuf *out, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0 || out_reserve(out, n + 1) < 0) return;
+    va_start(ap, fmt);
+    vsnprintf(out->data + out->used, n + 1, fmt, ap);
+    va_end(ap);
+    out->used += n;
+}
+
+int out_finish(OutBuf *out) {
+    if (out->fd >= 0) {
+        flush_out(out);
+        free(out->data);
+        out->data = NULL;
+        out->cap = 0;
+    }
+    return out->failed ? -1 : 0;
+}
+
+static void mode_string(mode_t mode, char out[11]) {
+    char type = '-';
+    if (S_ISDIR(mode)) type = 'd';
+    else if (S_ISLNK(mode)) type = 'l';
+    else if (S_ISCHR(mode)) type = 'c';
+    else if (S_ISBLK(mode)) type = 'b';
+    else if (S_ISFIFO(mode)) type = 'p';
+    else if (S_ISSOCK(mode)) type = 's';
+
+    out[0] = type;
+    const char *rwx = "rwxrwxrwx";
+    for (int i = 0; i < 9; i++) out[i + 1] = (mode & (0400 >> i)) ? rwx[i] : '-';
+    if (mode & S_ISUID) out[3] = (mode & S_IXUSR) ? 's' : 'S';
+    if (mode & S_ISGID) out[6] = (mode & S_IXGRP) ? 's' : 'S';
+    if (mode & S_ISVTX) out[9] = (mode & S_IXOTH) ? 't' : 'T';
+    out[10] = '\0';
+}
+
+static int digits(unsigned long long n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+void format_long(OutBuf *out, int dir_fd, const FileInfo *info, size_t count) {
+    IdCache users = {0}, groups = {0};
+    int w_links = 1, w_user = 1, w_group = 1, w_size = 1;
+    unsigned long long blocks = 0;
+
+    // First pass: column widths and the total, as ls prints them.
+    for (size_t i = 0; i < count; i++) {
+        const FileInfo *fi = &info[i];
+        if (!fi->ok) continue;
+        const char *user = cached_name(&users, fi->uid, 0);
+        const char *group = cached_name(&groups, fi->gid, 1);
+        int len;
+        if ((len = digits(fi->nlink)) > w_links) w_links = len;
+        if ((len = digits(fi->size)) > w_size) w_size = len;
+        if ((len = strlen(user)) > w_user) w_user = len;
+        if ((len = strlen(group)) > w_group) w_group = len;
+        blocks += fi->blocks;
+    }
+
+    out_printf(out, "total %llu\n", blocks / 2); // st_blocks is in 512-byte units
+
+    time_t now = time(NULL);
+    for (size_t i = 0; i < count; i++) {
+        const FileInfo *fi = &info[i];
+        if (!fi->ok) {
+            out_printf(out, "?????????? %*s %-*s %-*s %*s %12s %s\n", w_links, "?", w_user, "?",
+                       w_group, "?", w_size, "?", "?", fi->name);
+            continue;
+        }
+
+        char mode[11], date[32];
+        mode_string(fi->mode, mode);
+        struct tm tm;
+        localtime_r(&fi->mtime.tv_sec, &tm);
+        // Recent files show the time, older (or future) ones the year.
+        long age = (long)(now - fi->mtime.tv_sec);
+        strftime(date, sizeof(date), age >= 0 && age < SIX_MONTHS ? "%b %e %H:%M" : "%b %e  %Y", &tm);
+
+        out_printf(out, "%s %*lu %-*s %-*s %*lld %s %s", mode, w_links, (unsigned long)fi->nlink,
+                   w_user, cached_name(&users, fi->uid, 0), w_group, cached_name(&groups, fi->gid, 1),
+                   w_size, (long long)fi->size, date, fi->name);
+
+        if (S_ISLNK(fi->mode)) {
+            char target[PATH_MAX];
+            ssize_t n = readlinkat(dir_fd, fi->name, target, sizeof(target) - 1);
+            if (n >= 0) {
+                target[n] = '\0';
+                out_printf(out, " -> %s", target);
+            }
+        }
+        out_append(out, "\n", 1);
+    }
+    free(users.entries);
+    free(groups.entries);
+}
+
+int write_long(int dir_fd, const FileInfo *info, size_t count) {
+    OutBuf out;
+    fflush(stdout); // Anything printed earlier goes first.
+    out_init(&out, STDOUT_FILENO);
+    format_long(&out, dir_fd, info, count);
+    return out_finish(&out);
+}
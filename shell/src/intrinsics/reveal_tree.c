@@ -0,0 +1,399 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "intrinsics/reveal.h"
+#include "intrinsics/reveal_long.h"
+#include "intrinsics/reveal_tree.h"
+#include "trace.h"
+
+/*
+reveal -R: a directory tree listed by a pool of walker threads.
+
+Every directory is a DirNode. The worker that takes a node lists it into
+a chunk of output (header, sorted names) and creates a node for each
+subdirectory, in listing order, which it pushes onto its own deque. Workers
+pop their own deque from the back, so each one walks depth first, and
+steal from the front of the others', which hands out the biggest
+untouched subtrees. Nodes carry paths rather than open fds, so a wide
+tree cannot run the shell out of descriptors.
+
+The calling thread prints. It walks the nodes in the same order a
+single-threaded ls -R would, waiting for each one to be listed, and
+writes the chunks out in batches with writev. The output is therefore
+the same whatever the number of threads or the timing.
+*/
+
+#define DEFAULT_MIN_THREADS 4
+#define MAX_THREADS 64
+
+typedef struct DirNode DirNode;
+struct DirNode {
+    char *path;
+    int is_root;
+    // Set by the worker that lists the node, before done:
+    char *chunk;
+    size_t chunk_len;
+    DirNode **children;  // In listing order
+    size_t nchildren;
+    int done;
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    DirNode **items;     // items[head..tail)
+    size_t head;
+    size_t tail;
+    size_t cap;
+} Deque;
+
+typedef struct {
+    Deque *deques;
+    int nworkers;
+    pthread_mutex_t lock;    // Guards the counters and every node's done flag
+    pthread_cond_t work_cv;  // More queued, or nothing left at all
+    pthread_cond_t done_cv;  // A node has been listed
+    size_t queued;           // Nodes sitting in deques
+    size_t pending;          // Nodes not listed yet
+    int show_all;
+    int layout;
+    char sort_key;           // 0, 'S' or 't', as for a single directory
+} Walker;
+
+typedef struct {
+    Walker *walker;
+    int id;
+} Worker;
+
+/* ---------------- DEQUES ---------------- */
+
+static int deque_push(Deque *d, DirNode *node) {
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->cap) {
+        if (d->head > 0) { // Reuse the room thieves left at the front
+            memmove(d->items, d->items + d->head, (d->tail - d->head) * sizeof(DirNode *));
+            d->tail -= d->head;
+            d->head = 0;
+        } else {
+            size_t cap = d->cap ? d->cap * 2 : 64;
+            DirNode **bigger = realloc(d->items, cap * sizeof(DirNode *));
+            if (!bigger) {
+                pthread_mutex_unlock(&d->lock);
+                return -1;
+            }
+            d->items = bigger;
+            d->cap = cap;
+        }
+    }
+    d->items[d->tail++] = node;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+// The owner takes from the back, thieves from the front.
+static DirNode *deque_take(Deque *d, int steal) {
+    DirNode *node = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail) node = steal ? d->items[d->head++] : d->items[--d->tail];
+    if (d->head == d->tail) d->head = d->tail = 0;
+    pthread_mutex_unlock(&d->lock);
+    return node;
+}
+
+static void queue_node(Walker *w, int id, DirNode *node) {
+    pthread_mutex_lock(&w->lock);
+    w->pending++;
+    w->queued++;
+    pthread_mutex_unlock(&w->lock);
+    if (deque_push(&w->deques[id], node) < 0) {
+        // Out of memory: the node is reported as unreadable instead.
+        node->chunk = NULL;
+        node->chunk_len = 0;
+        pthread_mutex_lock(&w->lock);
+        w->queued--;
+        w->pending--;
+        node->done = 1;
+        pthread_cond_broadcast(&w->done_cv);
+        pthread_mutex_unlock(&w->lock);
+        return;
+    }
+    pthread_cond_signal(&w->work_cv);
+}
+
+static DirNode *next_node(Walker *w, int id) {
+    DirNode *node = deque_take(&w->deques[id], 0);
+    for (int k = 1; !node && k < w->nworkers; k++) {
+        node = deque_take(&w->deques[(id + k) % w->nworkers], 1);
+    }
+    if (node) {
+        pthread_mutex_lock(&w->lock);
+        w->queued--;
+        pthread_mutex_unlock(&w->lock);
+    }
+    return node;
+}
+
+/* ---------------- LISTING ---------------- */
+
+static int is_subdir(int dir_fd, const char *name, const FileInfo *info) {
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) return 0;
+    if (info && info->ok) return S_ISDIR(info->mode);
+    unsigned char type = NAME_TYPE(name);
+    if (type != DT_UNKNOWN) return type == DT_DIR;
+    struct stat st;
+    return fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+static DirNode *new_node(const char *parent, const char *name) {
+    DirNode *node = calloc(1, sizeof(DirNode));
+    if (!node) return NULL;
+    size_t plen = strlen(parent);
+    const char *sep = plen && parent[plen - 1] == '/' ? "" : "/";
+    size_t len = plen + strlen(sep) + strlen(name) + 1;
+    node->path = malloc(len);
+    if (!node->path) {
+        free(node);
+        return NULL;
+    }
+    snprintf(node->path, len, "%s%s%s", parent, sep, name);
+    return node;
+}
+
+static void list_dir(Walker *w, DirNode *node, NameList *list) {
+    OutBuf out;
+    out_init(&out, -1);
+    out_printf(&out, "%s%s:\n", node->is_root ? "" : "\n", node->path);
+
+    // Only the root may be reached through a symlink; links below it are
+    // listed but not followed, as in ls -R.
+    int fd = open(node->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC | (node->is_root ? 0 : O_NOFOLLOW));
+    reset_names(list);
+    if (fd < 0 || read_names(fd, w->show_all, list) < 0) {
+        out_printf(&out, "reveal: %s: %s\n", node->path, strerror(errno));
+        if (fd >= 0) close(fd);
+        node->chunk = out.data;
+        node->chunk_len = out.used;
+        return;
+    }
+    radix_sort(list->names, list->count, 0);
+
+    FileInfo *info = NULL;
+    if (w->layout == 'L' || w->sort_key) info = stat_names(fd, list->names, list->count);
+    if (info && w->sort_key) {
+        sort_by_info(info, list->count, w->sort_key == 't');
+        // Keep names[i] matching info[i] for the listing and the children.
+        for (size_t i = 0; i < list->count; i++) list->names[i] = info[i].name;
+    }
+    if (w->layout == 'L' && info) {
+        format_long(&out, fd, info, list->count);
+    } else {
+        char sep = w->layout ? '\n' : ' ';
+        for (size_t i = 0; i < list->count; i++) {
+            out_append(&out, list->names[i], strlen(list->names[i]));
+            out_append(&out, i == list->count - 1 ? "\n" : &sep, 1);
+        }
+    }
+
+    for (size_t i = 0; i < list->count; i++) {
+        if (!is_subdir(fd, list->names[i], info ? &info[i] : NULL)) continue;
+        if (node->nchildren % 64 == 0) {
+            DirNode **bigger = realloc(node->children, (node->nchildren + 64) * sizeof(DirNode *));
+            if (!bigger) break;
+            node->children = bigger;
+        }
+        DirNode *child = new_node(node->path, list->names[i]);
+        if (!child) break;
+        node->children[node->nchildren++] = child;
+    }
+    free(info);
+    close(fd);
+    node->chunk = out.data;
+    node->chunk_len = out.used;
+}
+
+static void *worker_main(void *arg) {
+    Worker *self = arg;
+    Walker *w = self->walker;
+    NameList list = {0};
+
+    while (1) {
+        DirNode *node = next_node(w, self->id);
+        if (!node) {
+            pthread_mutex_lock(&w->lock);
+            while (w->queued == 0 && w->pending > 0) pthread_cond_wait(&w->work_cv, &w->lock);
+            int finished = w->pending == 0;
+            pthread_mutex_unlock(&w->lock);
+            if (finished) break;
+            continue;
+        }
+
+        long long span = trace_begin();
+        list_dir(w, node, &list);
+        trace_end(span, "list_dir", node->path);
+        // Pushed last first, so this worker carries on with the first one.
+        for (size_t i = node->nchildren; i > 0; i--) queue_node(w, self->id, node->children[i - 1]);
+
+        pthread_mutex_lock(&w->lock);
+        node->done = 1;
+        if (--w->pending == 0) pthread_cond_broadcast(&w->work_cv);
+        pthread_cond_broadcast(&w->done_cv);
+        pthread_mutex_unlock(&w->lock);
+    }
+    free_names(&list);
+    return NULL;
+}
+
+/* ---------------- OUTPUT ---------------- */
+
+typedef struct {
+    struct iovec iov[IOV_MAX];
+    char *owned[IOV_MAX];
+    int count;
+    int failed;
+} Batch;
+
+static void write_batch(Batch *b) {
+    struct iovec *cur = b->iov;
+    int niov = b->count;
+    while (!b->failed && niov > 0) {
+        ssize_t n = writev(STDOUT_FILENO, cur, niov);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("reveal");
+            b->failed = 1;
+            break;
+        }
+        while (niov > 0 && (size_t)n >= cur->iov_len) {
+            n -= cur->iov_len;
+            cur++;
+            niov--;
+        }
+        if (niov > 0) {
+            cur->iov_base = (char *)cur->iov_base + n;
+            cur->iov_len -= n;
+        }
+    }
+    for (int i = 0; i < b->count; i++) free(b->owned[i]);
+    b->count = 0;
+}
+
+static int thread_count(void) {
+    const char *env = getenv("REVEAL_THREADS");
+    long n = env && *env ? strtol(env, NULL, 10) : 0;
+    if (n <= 0) {
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+        // Listing is mostly waiting on the filesystem; overlap some of it
+        // even on a small machine.
+        if (n < DEFAULT_MIN_THREADS) n = DEFAULT_MIN_THREADS;
+    }
+    return n > MAX_THREADS ? MAX_THREADS : (int)n;
+}
+
+int reveal_tree(const char *root, int show_all, int layout, char sort_key) {
+    Walker w;
+    w.nworkers = thread_count();
+    w.deques = calloc(w.nworkers, sizeof(Deque));
+    Worker *workers = calloc(w.nworkers, sizeof(Worker));
+    pthread_t *threads = calloc(w.nworkers, sizeof(pthread_t));
+    DirNode *top = calloc(1, sizeof(DirNode));
+    Batch *batch = malloc(sizeof(Batch));
+    if (!w.deques || !workers || !threads || !top || !batch || !(top->path = strdup(root))) {
+        perror("reveal");
+        free(w.deques);
+        free(workers);
+        free(threads);
+        if (top) free(top->path);
+        free(top);
+        free(batch);
+        return 1;
+    }
+    pthread_mutex_init(&w.lock, NULL);
+    pthread_cond_init(&w.work_cv, NULL);
+    pthread_cond_init(&w.done_cv, NULL);
+    w.queued = w.pending = 0;
+    w.show_all = show_all;
+    w.layout = layout;
+    w.sort_key = sort_key;
+    for (int i = 0; i < w.nworkers; i++) {
+        pthread_mutex_init(&w.deques[i].lock, NULL);
+        workers[i] = (Worker){ &w, i };
+    }
+
+    top->is_root = 1;
+    queue_node(&w, 0, top);
+    int started = 0;
+    for (int i = 0; i < w.nworkers; i++) {
+        if (pthread_create(&threads[started], NULL, worker_main, &workers[i]) == 0) started++;
+    }
+    if (started == 0) worker_main(&workers[0]); // No threads: walk it all here first.
+
+    // Emit in pre-order with an explicit stack; children are pushed last
+    // first so the first one comes out next.
+    fflush(stdout);
+    batch->count = 0;
+    batch->failed = 0;
+    DirNode **stack = NULL;
+    size_t depth = 0, cap = 0;
+    DirNode *node = top;
+    while (node) {
+        pthread_mutex_lock(&w.lock);
+        if (!node->done) {
+            // Do not sit on finished output while waiting.
+            pthread_mutex_unlock(&w.lock);
+            write_batch(batch);
+            pthread_mutex_lock(&w.lock);
+            while (!node->done) pthread_cond_wait(&w.done_cv, &w.lock);
+        }
+        pthread_mutex_unlock(&w.lock);
+
+        if (node->chunk) {
+            batch->iov[batch->count] = (struct iovec){ node->chunk, node->chunk_len };
+            batch->owned[batch->count++] = node->chunk;
+            if (batch->count == IOV_MAX) write_batch(batch);
+        }
+        if (depth + node->nchildren > cap) {
+            size_t bigger_cap = cap ? cap : 64;
+            while (bigger_cap < depth + node->nchildren) bigger_cap *= 2;
+            DirNode **bigger = realloc(stack, bigger_cap * sizeof(DirNode *));
+            if (!bigger) {
+                // The walk still runs to completion below; only the rest
+                // of the output is lost.
+                perror("reveal");
+                batch->failed = 1;
+                break;
+            }
+            stack = bigger;
+            cap = bigger_cap;
+        }
+        for (size_t i = node->nchildren; i > 0; i--) stack[depth++] = node->children[i - 1];
+        free(node->children);
+        free(node->path);
+        free(node);
+        node = depth ? stack[--depth] : NULL;
+    }
+    write_batch(batch);
+    int failed = batch->failed;
+
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    for (int i = 0; i < w.nworkers; i++) {
+        pthread_mutex_destroy(&w.deques[i].lock);
+        free(w.deques[i].items);
+    }
+    pthread_mutex_destroy(&w.lock);
+    pthread_cond_destroy(&w.work_cv);
+    pthread_cond_destroy(&w.done_cv);
+    free(stack);
+    free(batch);
+    free(threads);
+    free(workers);
+    free(w.deques);
+    return failed ? 1 : 0;
+}
@@ -1,70 +1,127 @@
 #include "input/prompt.h"
 #include "input/input.h"
+#include "input/editor.h"
+#include "input/loop.h"
 #include "input/parser.h"
 #include "intrinsics/hop.h"
 #include "intrinsics/log.h"
+#include "intrinsics/hash.h"
+#include "intrinsics/dircache.h"
 #include "jobs/jobs.h"
 #include "jobs/execution.h"
 #include "exotic/signals.h"
+#include "arena.h"
+#include "trace.h"
+#include "metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
-int main(void) {
-    // Make the shell interactive and take control of the terminal.
-    setpgid(0, 0);
-    tcsetpgrp(STDIN_FILENO, getpgrp());
-    init_signal_handlers();
+// Runs one line of input and returns its exit status. Interactive lines
+// are recorded in the log; script lines are not.
+static int run_line(char *line, int interactive, int last_status) {
+    // Check for completed jobs and print messages before processing the next command
+    check_jobs();
+    print_completed_jobs();
 
+    if (strlen(line) == 0) return last_status;
+
+    // Handle log execute command replacement before parsing
+    long long span = trace_begin();
+    const char *processed_line = process_log_execute(line);
+    trace_end(span, "process_log_execute", line);
+    if (processed_line == NULL) {
+        // Error occurred in process_log_execute (e.g., infinite loop detected)
+        // The error is already printed, so just continue.
+        return 1;
+    }
+
+    // The line is lexed once; the executor runs the resulting tree.
+    span = trace_begin();
+    CommandLine *cmdline = parse_command(processed_line);
+    trace_end(span, "parse_command", processed_line);
+    if (!cmdline) {
+        printf("Invalid Syntax!\n");
+        return 2;
+    }
+    // Log the original, un-expanded command
+    if (interactive) add_to_log(line);
+    span = trace_begin();
+    int status = handle_execution_flow(cmdline);
+    trace_end(span, "handle_execution_flow", processed_line);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    // "shell.out -c CMD" and "shell.out FILE" run non-interactively: no
+    // prompt, no terminal handoff, and the exit status of the last command.
+    int interactive = argc < 2;
+    if (argc >= 2 && strcmp(argv[1], "-c") == 0) {
+        if (argc < 3) {
+            printf("-c: option requires an argument\n");
+            return 2;
+        }
+        open_script_string(argv[2]);
+    } else if (argc >= 2) {
+        if (open_script(argv[1]) < 0) return 127;
+    }
+
+    if (interactive) {
+        // Make the shell interactive and take control of the terminal.
+        setpgid(0, 0);
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+        init_signal_handlers();
+    } else {
+        set_job_control(0);
+    }
+
+    init_trace();
     init_hop();
+    if (interactive) init_prompt();
     init_log();
     init_jobs();
-    
-    while (1) {
-        show_prompt();
-        char *line = read_input();
+    init_metrics();
 
-        if (!line) { // Ctrl+D was pressed (EOF)
-            printf("logout\n");
-            kill_all_jobs();
-            break; 
+    int status = 0;
+    while (1) {
+        if (interactive) {
+            // Jobs that finished while the last line ran are reported
+            // before the prompt; later ones while it is up (see editor.c).
+            check_jobs();
+            print_completed_jobs();
+            show_prompt();
         }
-        
-        // Check for completed jobs and print messages before processing the next command
-        check_jobs();
-        print_completed_jobs();
-        
-        if (strlen(line) > 0) {
-            // Handle log execute command replacement before parsing
-            char *processed_line = process_log_execute(line);
-            
-            if (processed_line == NULL) {
-                // Error occurred in process_log_execute (e.g., infinite loop detected)
-                // The error is already printed, so just continue.
-            } else {
-                // A copy is needed for the parser because it's destructive (uses strtok)
-                char *line_for_parser = strdup(processed_line);
-                if (!line_for_parser) {
-                    perror("strdup");
-                } else {
-                    if (!parse_command(line_for_parser)) {
-                        printf("Invalid Syntax!\n");
-                    } else {
-                        // Log the original, un-expanded command
-                        add_to_log(line); 
-                        handle_execution_flow(processed_line);
-                    }
-                    free(line_for_parser);
-                }
-                free(processed_line);
+        char *line = interactive ? read_input() : read_script_line();
+
+        if (!line) { // Ctrl+D was pressed (EOF), or the script ended
+            if (interactive) {
+                printf("logout\n");
+                kill_all_jobs();
             }
+            break;
         }
-        free(line);
+
+        status = run_line(line, interactive, status);
+        // Everything built for this line goes at once.
+        arena_reset(&line_arena);
+        const ArenaStats *arena = arena_stats(&line_arena);
+        metric_set(METRIC_ARENA_BYTES, arena->reserved);
+        metric_set(METRIC_ARENA_ALLOCATIONS, arena->allocations);
+        metric_set(METRIC_ARENA_HEAP_CALLS, arena->heap_calls);
     }
 
+    close_script();
+    cleanup_metrics();
+    cleanup_editor();
+    cleanup_loop();
     cleanup_hop();
     cleanup_log();
+    cleanup_hash();
+    cleanup_dircache();
     cleanup_jobs();
-    return 0;
-}
\ No newline at end of file
+    cleanup_trace();
+    arena_destroy(&line_arena);
+    fflush(stdout);
+    return status;
+}
@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <malloc.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "metrics.h"
+
+/*
+Every metric is a fixed slot, named by its enum value, so recording one
+is a relaxed atomic add or store with no lookup. Histograms keep one
+counter per bucket plus a running sum. Buckets are made cumulative only
+when they are written out. A reader may see a sum and bucket counts that
+are one observation apart, which OpenMetrics consumers tolerate.
+
+The export thread sleeps on a timerfd and an eventfd (to be told to
+stop), with every signal blocked, so Ctrl+C still interrupts the main
+thread. The thread touches nothing but the slots and malloc's statistics.
+*/
+
+#define DEFAULT_EXPORT_INTERVAL 10
+
+typedef struct {
+    const char *name;
+    const char *help;
+    const char *unit;  // NULL if none
+    int is_gauge;
+} MetricInfo;
+
+static const MetricInfo metric_info[METRIC_COUNT] = {
+    [METRIC_COMMANDS] = { "shell_commands", "Pipelines and single commands run.", NULL, 0 },
+    [METRIC_BUILTINS] = { "shell_builtins", "Builtins run, in the shell or forked.", NULL, 0 },
+    [METRIC_EXTERNALS] = { "shell_externals", "External programs started.", NULL, 0 },
+    [METRIC_JOBS] = { "shell_jobs", "Jobs in the job table.", NULL, 1 },
+    [METRIC_HISTORY_BYTES] = { "shell_history_bytes", "Size of the history file.", "bytes", 1 },
+    [METRIC_ARENA_BYTES] = { "shell_line_arena_bytes", "Bytes held by the line arena.", "bytes", 1 },
+    [METRIC_ARENA_ALLOCATIONS] = { "shell_line_arena_allocations",
+                                   "Blocks the line arena has handed out.", NULL, 0 },
+    [METRIC_ARENA_HEAP_CALLS] = { "shell_line_arena_heap_calls",
+                                  "malloc() calls the line arena made for chunks.", NULL, 0 },
+};
+
+// Upper bounds in nanoseconds; the last bucket is +Inf.
+static const long long spawn_bounds[] = {
+    50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000,
+};
+#define SPAWN_BUCKETS (sizeof(spawn_bounds) / sizeof(spawn_bounds[0]) + 1)
+
+typedef struct {
+    const char *name;
+    const char *help;
+    const long long *bounds;
+    size_t nbuckets;
+} HistogramInfo;
+
+static const HistogramInfo histogram_info[HISTOGRAM_COUNT] = {
+    [HISTOGRAM_SPAWN] = { "shell_spawn_seconds", "Time to start a process (posix_spawn or fork).",
+                          spawn_bounds, SPAWN_BUCKETS },
+};
+
+static long metric_values[METRIC_COUNT];
+static long spawn_counts[SPAWN_BUCKETS];
+static long *histogram_counts[HISTOGRAM_COUNT] = { [HISTOGRAM_SPAWN] = spawn_counts };
+static long long histogram_sums[HISTOGRAM_COUNT];
+
+static pthread_t exporter;
+static int exporter_running = 0;
+static int stop_fd = -1;
+static char *export_path = NULL;
+static int export_interval = DEFAULT_EXPORT_INTERVAL;
+
+void metric_add(MetricId id, long delta) {
+    __atomic_fetch_add(&metric_values[id], delta, __ATOMIC_RELAXED);
+}
+
+void metric_set(MetricId id, long value) {
+    __atomic_store_n(&metric_values[id], value, __ATOMIC_RELAXED);
+}
+
+void metric_observe(HistogramId id, long long ns) {
+    const HistogramInfo *info = &histogram_info[id];
+    size_t b = 0;
+    while (b < info->nbuckets - 1 && ns > info->bounds[b]) b++;
+    __atomic_fetch_add(&histogram_counts[id][b], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram_sums[id], ns, __ATOMIC_RELAXED);
+}
+
+long long metric_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* ---------------- OUTPUT ---------------- */
+
+static void write_family(FILE *f, const char *name, const char *type, const char *unit,
+                         const char *help) {
+    fprintf(f, "# TYPE %s %s\n", name, type);
+    if (unit) fprintf(f, "# UNIT %s %s\n", name, unit);
+    fprintf(f, "# HELP %s %s\n", name, help);
+}
+
+void write_metrics(FILE *f) {
+    for (int id = 0; id < METRIC_COUNT; id++) {
+        const MetricInfo *info = &metric_info[id];
+        long value = __atomic_load_n(&metric_values[id], __ATOMIC_RELAXED);
+        write_family(f, info->name, info->is_gauge ? "gauge" : "counter", info->unit, info->help);
+        fprintf(f, "%s%s %ld\n", info->name, info->is_gauge ? "" : "_total", value);
+    }
+
+    // Read from malloc itself, so it is always current.
+    struct mallinfo2 heap = mallinfo2();
+    write_family(f, "shell_heap_bytes", "gauge", "bytes", "Heap memory in use, from mallinfo2.");
+    fprintf(f, "shell_heap_bytes %zu\n", heap.uordblks + heap.hblkhd);
+
+    for (int id = 0; id < HISTOGRAM_COUNT; id++) {
+        const HistogramInfo *info = &histogram_info[id];
+        write_family(f, info->name, "histogram", "seconds", info->help);
+        long total = 0;
+        for (size_t b = 0; b < info->nbuckets; b++) {
+            total += __atomic_load_n(&histogram_counts[id][b], __ATOMIC_RELAXED);
+            if (b < info->nbuckets - 1) {
+                fprintf(f, "%s_bucket{le=\"%g\"} %ld\n", info->name, info->bounds[b] / 1e9, total);
+            } else {
+                fprintf(f, "%s_bucket{le=\"+Inf\"} %ld\n", info->name, total);
+            }
+        }
+        long long sum = __atomic_load_n(&histogram_sums[id], __ATOMIC_RELAXED);
+        fprintf(f, "%s_sum %.9f\n", info->name, sum / 1e9);
+        fprintf(f, "%s_count %ld\n", info->name, total);
+    }
+    fprintf(f, "# EOF\n");
+}
+
+// Writes the metrics beside path and renames the result over it.
+static int write_metrics_file(const char *path) {
+    size_t len = strlen(path) + 5;
+    char *tmp = malloc(len);
+    if (!tmp) return -1;
+    snprintf(tmp, len, "%s.tmp", path);
+
+    int result = -1;
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    FILE *f = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (f) {
+        write_metrics(f);
+        if (fclose(f) == 0 && rename(tmp, path) == 0) result = 0;
+    } else if (fd >= 0) {
+        close(fd);
+    }
+    int saved = errno;
+    if (result < 0) unlink(tmp);
+    free(tmp);
+    errno = saved;
+    return result;
+}
+
+/* ---------------- EXPORT ---------------- */
+
+static void *export_main(void *arg) {
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer < 0) return NULL;
+    struct itimerspec every = { { export_interval, 0 }, { export_interval, 0 } };
+    timerfd_settime(timer, 0, &every, NULL);
+
+    struct pollfd fds[2] = { { timer, POLLIN, 0 }, { stop_fd, POLLIN, 0 } };
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;
+        uint64_t ticks;
+        if (read(timer, &ticks, sizeof(ticks)) != sizeof(ticks)) continue;
+        write_metrics_file(export_path);
+    }
+    close(timer);
+    return NULL;
+}
+
+// The export path made absolute, so that hop does not move the file: the
+// directory is resolved, the name kept as given (it may be a symlink).
+static char *absolute_path(const char *path) {
+    char *dir_copy = strdup(path);
+    char *base_copy = strdup(path);
+    char *dir = dir_copy ? realpath(dirname(dir_copy), NULL) : NULL;
+    char *result = NULL;
+    if (dir && base_copy) {
+        const char *base = basename(base_copy);
+        size_t len = strlen(dir) + strlen(base) + 2;
+        result = malloc(len);
+        if (result) snprintf(result, len, "%s/%s", strcmp(dir, "/") ? dir : "", base);
+    }
+    free(dir);
+    free(dir_copy);
+    free(base_copy);
+    return result;
+}
+
+int metrics_export_start(const char *path, int interval_s) {
+    metrics_export_stop();
+    if (write_metrics_file(path) < 0) {
+        fprintf(stderr, "stats: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    free(export_path);
+    export_path = absolute_path(path);
+    export_interval = interval_s;
+    if (!export_path || (stop_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+        perror("stats");
+        return -1;
+    }
+
+    // The thread inherits a fully blocked mask: signals stay with the main
+    // thread, where the handlers and signalfds expect them.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&exporter, NULL, export_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err) {
+        fprintf(stderr, "stats: %s\n", strerror(err));
+        close(stop_fd);
+        stop_fd = -1;
+        return -1;
+    }
+    exporter_running = 1;
+    return 0;
+}
+
+void metrics_export_stop(void) {
+    if (!exporter_running) return;
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) perror("stats");
+    pthread_join(exporter, NULL);
+    exporter_running = 0;
+    close(stop_fd);
+    stop_fd = -1;
+    write_metrics_file(export_path); // The final numbers
+}
+
+static int parse_interval(const char *text) {
+    char *end;
+    long n = strtol(text, &end, 10);
+    return *end == '\0' && end != text && n > 0 && n <= 86400 ? (int)n : -1;
+}
+
+void init_metrics(void) {
+    const char *path = getenv("SHELL_METRICS");
+    if (!path || !*path) return;
+    const char *interval = getenv("SHELL_METRICS_INTERVAL");
+    int seconds = interval && *interval ? parse_interval(interval) : DEFAULT_EXPORT_INTERVAL;
+    metrics_export_start(path, seconds > 0 ? seconds : DEFAULT_EXPORT_INTERVAL);
+}
+
+void cleanup_metrics(void) {
+    metrics_export_stop();
+    free(export_path);
+    export_path = NULL;
+}
+
+int stats_command(int argc, char **argv) {
+    if (argc == 1) {
+        write_metrics(stdout);
+        return 0;
+    }
+    if (argc == 3 && strcmp(argv[1], "export") == 0 && strcmp(argv[2], "off") == 0) {
+        metrics_export_stop();
+        return 0;
+    }
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "export") == 0) {
+        int seconds = argc == 4 ? parse_interval(argv[3]) : DEFAULT_EXPORT_INTERVAL;
+        if (seconds < 0) {
+            printf("stats: invalid interval\n");
+            return 2;
+        }
+        return metrics_export_start(argv[2], seconds) < 0;
+    }
+    printf("stats: usage: stats | stats export FILE [SECONDS] | stats export off\n");
+    return 2;
+}
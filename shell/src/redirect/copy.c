@@ -0,0 +1,81 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include "redirect/copy.h"
+
+#define COPY_CHUNK (1024 * 1024)
+#define READ_WRITE_BUF (128 * 1024)
+
+typedef enum { VIA_COPY_RANGE, VIA_SPLICE, VIA_SENDFILE, VIA_READ_WRITE } CopyMethod;
+
+static ssize_t write_all(int fd, const char *buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, buf + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += n;
+    }
+    return done;
+}
+
+static ssize_t read_write(int in_fd, int out_fd) {
+    static char buf[READ_WRITE_BUF];
+    ssize_t n = read(in_fd, buf, sizeof(buf));
+    if (n <= 0) return n;
+    return write_all(out_fd, buf, n);
+}
+
+static ssize_t move_chunk(CopyMethod method, int in_fd, int out_fd) {
+    switch (method) {
+    case VIA_COPY_RANGE: return copy_file_range(in_fd, NULL, out_fd, NULL, COPY_CHUNK, 0);
+    case VIA_SPLICE: return splice(in_fd, NULL, out_fd, NULL, COPY_CHUNK, SPLICE_F_MOVE);
+    case VIA_SENDFILE: return sendfile(out_fd, in_fd, NULL, COPY_CHUNK);
+    default: return read_write(in_fd, out_fd);
+    }
+}
+
+// Errors that mean "not between these two files", as opposed to real ones.
+static int unsupported(int err) {
+    return err == EINVAL || err == ENOSYS || err == EXDEV || err == EOPNOTSUPP ||
+           err == EBADF || err == ESPIPE;
+}
+
+int copy_fd(int in_fd, int out_fd, volatile sig_atomic_t *stop) {
+    struct stat in_st, out_st;
+    if (fstat(in_fd, &in_st) < 0 || fstat(out_fd, &out_st) < 0) return -1;
+
+    // copy_file_range copies nothing from files that report a size of 0
+    // but have contents, such as those in /proc.
+    int in_file = S_ISREG(in_st.st_mode);
+    CopyMethod method = VIA_READ_WRITE;
+    if (in_file && in_st.st_size > 0 && S_ISREG(out_st.st_mode)) {
+        method = VIA_COPY_RANGE;
+    } else if (S_ISFIFO(in_st.st_mode) || S_ISFIFO(out_st.st_mode)) {
+        method = VIA_SPLICE;
+    } else if (in_file) {
+        method = VIA_SENDFILE;
+    }
+
+    while (1) {
+        if (stop && *stop) {
+            errno = EINTR;
+            return -1;
+        }
+        ssize_t n = move_chunk(method, in_fd, out_fd);
+        if (n > 0) continue;
+        if (n == 0) return 0;
+        if (errno == EINTR) continue;
+        if (method == VIA_READ_WRITE || !unsupported(errno)) return -1;
+        // Offsets only move with what was copied, so the next method
+        // carries on from the same place.
+        method = method != VIA_SENDFILE && in_file ? VIA_SENDFILE : VIA_READ_WRITE;
+    }
+}
@@ -5,14 +5,20 @@
 
 #include "redirect/input_redirect.h"
 
-int handle_input_redirection(const char *filename) {
-    if (!filename) return 0;
-
-    int fd_in = open(filename, O_RDONLY);
+int open_input_file(const char *filename) {
+    int fd_in = open(filename, O_RDONLY | O_CLOEXEC);
     if (fd_in < 0) {
         printf("No such file or directory\n");
         return -1;
     }
+    return fd_in;
+}
+
+int handle_input_redirection(const char *filename) {
+    if (!filename) return 0;
+
+    int fd_in = open_input_file(filename);
+    if (fd_in < 0) return -1;
 
     if (dup2(fd_in, STDIN_FILENO) < 0) {
         perror("dup2");
@@ -5,10 +5,8 @@
 
 #include "redirect/output_redirect.h"
 
-int handle_output_redirection(const char *filename, int append) {
-    if (!filename) return 0;
-
-    int flags = O_WRONLY | O_CREAT;
+int open_output_file(const char *filename, int append) {
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
     flags |= (append ? O_APPEND : O_TRUNC);
 
     int fd_out = open(filename, flags, 0644);
@@ -16,6 +14,14 @@ int handle_output_redirection(const char *filename, int append) {
         printf("Unable to create file for writing\n");
         return -1;
     }
+    return fd_out;
+}
+
+int handle_output_redirection(const char *filename, int append) {
+    if (!filename) return 0;
+
+    int fd_out = open_output_file(filename, append);
+    if (fd_out < 0) return -1;
 
     if (dup2(fd_out, STDOUT_FILENO) < 0) {
         perror("dup2");
@@ -1,115 +1,93 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <sys/wait.h>
 #include "redirect/pipe.h"
 #include "cmd_exec.h"
 #include "exotic/signals.h"
 #include "jobs/jobs.h"
+#include "arena.h"
 
-#define MAX_CMDS 16
+int execute_pipeline(const Pipeline *pipeline) {
+    int ncmds = pipeline->ncmds;
+    int is_background = pipeline->is_background;
+    if (ncmds < 1) return 0;
 
-static int split_pipeline(char *line, char *commands[MAX_CMDS]) {
-    int count = 0;
-    char *line_ptr = line;
-    while ((commands[count] = strtok_r(line_ptr, "|", &line_ptr)) && count < MAX_CMDS) {
-        count++;
-    }
-    return count;
-}
-
-void execute_pipeline(char *line, int is_background) {
-    // *** THE FIX IS HERE: Create a copy of the line for job logging ***
-    char *full_command_for_job = strdup(line);
-    if (!full_command_for_job) {
-        perror("strdup");
-        return;
-    }
-    
-    char *commands[MAX_CMDS];
-    int ncmds = split_pipeline(line, commands);
-    if (ncmds < 1) {
-        free(full_command_for_job);
-        return;
-    }
-
-    pid_t pids[MAX_CMDS];
+    pid_t *pids = arena_alloc(&line_arena, ncmds * sizeof(pid_t));
+    if (!pids) return 1;
+    int nlaunched = 0;
     pid_t pgid = 0;
     int pipefds[2];
-    int in_fd = STDIN_FILENO;
+    int in_fd = -1;
+    int last_launched = 0;
 
     for (int i = 0; i < ncmds; i++) {
+        int out_fd = -1;
         if (i < ncmds - 1) {
-            pipe(pipefds);
+            // Close-on-exec, so no stage inherits pipe ends it does not use.
+            if (pipe2(pipefds, O_CLOEXEC) < 0) {
+                perror("pipe");
+                break;
+            }
+            out_fd = pipefds[1];
         }
 
-        pid_t pid = fork();
-
-        if (pid == 0) { // Child
-            if (pgid == 0) pgid = getpid();
-            setpgid(0, pgid);
-
-            if (in_fd != STDIN_FILENO) {
-                dup2(in_fd, STDIN_FILENO);
-                close(in_fd);
-            }
-            if (i < ncmds - 1) {
-                dup2(pipefds[1], STDOUT_FILENO);
-                close(pipefds[0]);
-                close(pipefds[1]);
-            }
-            
-            signal(SIGINT, SIG_DFL);
-            signal(SIGTSTP, SIG_DFL);
-            
-            // Create a mutable copy for dispatch_command
-            char *cmd_copy = strdup(commands[i]);
-            dispatch_command(cmd_copy, is_background);
-            free(cmd_copy);
-            exit(127);
-        } else { // Parent
+        // Each stage is spawned straight from the shell; only the first one
+        // launched needs to take the terminal, the rest join its group.
+        pid_t pid = launch_pipeline_stage(&pipeline->cmds[i], in_fd, out_fd, pgid,
+                                          !is_background && pgid == 0);
+        if (pid > 0) {
             if (pgid == 0) pgid = pid;
-            setpgid(pid, pgid);
-            pids[i] = pid;
+            pids[nlaunched++] = pid;
+        }
+        last_launched = pid > 0;
 
-            if (in_fd != STDIN_FILENO) close(in_fd);
-            if (i < ncmds - 1) {
-                in_fd = pipefds[0];
-                close(pipefds[1]);
-            }
+        if (in_fd != -1) close(in_fd);
+        in_fd = -1;
+        if (i < ncmds - 1) {
+            in_fd = pipefds[0];
+            close(pipefds[1]);
         }
     }
-    
-    if (!is_background) {
-        g_foreground_pgid = pgid;
-        tcsetpgrp(STDIN_FILENO, pgid);
-        
-        int status;
-        int last_pid = pids[ncmds - 1];
-        waitpid(last_pid, &status, WUNTRACED);
-        
-        for (int i = 0; i < ncmds - 1; i++) {
-            waitpid(pids[i], NULL, WNOHANG);
-        }
+    if (in_fd != -1) close(in_fd);
 
-        if (WIFSTOPPED(status)) {
-            // *** THE FIX IS HERE: Use the pristine copy of the command ***
-            add_job(pgid, full_command_for_job, STOPPED);
+    if (nlaunched == 0) return 1;
+    
+    if (is_background) {
+        // The job list shows the command as typed, including the '&'.
+        size_t text_len = strlen(pipeline->text);
+        char *bg_command = arena_alloc(&line_arena, text_len + 3);
+        if (bg_command) {
+            memcpy(bg_command, pipeline->text, text_len);
+            memcpy(bg_command + text_len, " &", 3);
         }
+        // The job is running either way; without memory it keeps the plain text.
+        add_job(pgid, pids, NULL, nlaunched, bg_command ? bg_command : pipeline->text, RUNNING);
+        return 0;
+    }
 
-        tcsetpgrp(STDIN_FILENO, getpgrp());
-        g_foreground_pgid = 0;
+    g_foreground_pgid = pgid;
+    if (job_control_enabled()) tcsetpgrp(STDIN_FILENO, pgid);
 
-    } else {
-        // *** THE FIX IS HERE: Use the pristine copy of the command ***
-        char *bg_command = malloc(strlen(full_command_for_job) + 3);
-        sprintf(bg_command, "%s &", full_command_for_job);
-        add_job(pgid, bg_command, RUNNING);
-        free(bg_command);
+    // Every stage is waited for, not just the last one, so none of them
+    // outlives the pipeline unnoticed and each has its own exit status.
+    // As in a POSIX shell, the pipeline's status is that of its last stage.
+    int result = 1;
+    int *statuses = arena_alloc(&line_arena, nlaunched * sizeof(int));
+    if (statuses) {
+        if (wait_for_stages(pgid, pids, statuses, nlaunched)) {
+            add_job(pgid, pids, statuses, nlaunched, pipeline->text, STOPPED);
+            result = 128 + SIGTSTP;
+        } else if (last_launched) {
+            result = exit_status(statuses[nlaunched - 1]);
+        }
     }
-    
-    // *** THE FIX IS HERE: Free the allocated copy ***
-    free(full_command_for_job);
+
+    if (job_control_enabled()) tcsetpgrp(STDIN_FILENO, getpgrp());
+    g_foreground_pgid = 0;
+    return result;
 }
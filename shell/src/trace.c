@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+/*
+Each thread that records a span gets a ring of TRACE_RING_EVENTS events,
+found through a pthread key so recording takes no lock. When the ring is
+full the oldest spans are overwritten: a long session keeps its most
+recent history. A thread that exits leaves its ring to the next thread
+that needs one, so reveal -R does not add rings on every run.
+
+The rings are only read when the trace is written, from the main thread,
+at a point where no walker threads are running.
+*/
+
+#define TRACE_RING_EVENTS 16384
+#define TRACE_DETAIL 36
+
+typedef struct {
+    const char *name;
+    long long start;   // ns
+    long long dur;     // ns
+    int tid;
+    char detail[TRACE_DETAIL];
+} TraceEvent;
+
+typedef struct TraceRing {
+    struct TraceRing *next;
+    int tid;
+    int in_use;
+    unsigned long written;   // Events ever recorded; the last ones are kept
+    TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+int trace_active = 0;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing *rings = NULL;
+
+static char *trace_path = NULL;
+static int trace_fd = -1;
+static pid_t trace_owner = 0; // Forked children inherit the state but never write
+
+long long trace_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void release_ring(void *ring) {
+    pthread_mutex_lock(&rings_lock);
+    ((TraceRing *)ring)->in_use = 0;
+    pthread_mutex_unlock(&rings_lock);
+}
+
+static void make_key(void) {
+    pthread_key_create(&ring_key, release_ring);
+}
+
+static TraceRing *claim_ring(void) {
+    pthread_mutex_lock(&rings_lock);
+    TraceRing *ring = rings;
+    while (ring && ring->in_use) ring = ring->next;
+    if (!ring && (ring = calloc(1, sizeof(TraceRing)))) {
+        ring->next = rings;
+        rings = ring;
+    }
+    if (ring) {
+        ring->in_use = 1;
+        ring->tid = gettid();
+    }
+    pthread_mutex_unlock(&rings_lock);
+    if (ring) pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+void trace_record(long long start, const char *name, const char *detail) {
+    long long end = trace_clock();
+    TraceRing *ring = pthread_getspecific(ring_key);
+    if (!ring && !(ring = claim_ring())) return;
+
+    TraceEvent *e = &ring->events[ring->written++ % TRACE_RING_EVENTS];
+    e->name = name;
+    e->start = start;
+    e->dur = end - start;
+    e->tid = ring->tid;
+    e->detail[0] = '\0';
+    if (detail) snprintf(e->detail, sizeof(e->detail), "%s", detail);
+}
+
+/* ---------------- OUTPUT ---------------- */
+
+static void write_escaped(FILE *f, const char *s) {
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            fprintf(f, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+}
+
+// Writes every ring, oldest event first, and empties them.
+static int write_trace(FILE *f) {
+    int pid = getpid();
+    int count = 0;
+    unsigned long dropped = 0;
+    fprintf(f, "{\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+               "\"args\":{\"name\":\"shell\"}}", pid, pid);
+
+    pthread_mutex_lock(&rings_lock);
+    for (TraceRing *ring = rings; ring; ring = ring->next) {
+        unsigned long first = 0;
+        if (ring->written > TRACE_RING_EVENTS) {
+            first = ring->written - TRACE_RING_EVENTS;
+            dropped += first;
+        }
+        for (unsigned long i = first; i < ring->written; i++) {
+            const TraceEvent *e = &ring->events[i % TRACE_RING_EVENTS];
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"shell\",\"ph\":\"X\",\"ts\":%lld.%03lld,"
+                       "\"dur\":%lld.%03lld,\"pid\":%d,\"tid\":%d",
+                    e->name, e->start / 1000, e->start % 1000, e->dur / 1000, e->dur % 1000,
+                    pid, e->tid);
+            if (e->detail[0]) {
+                fprintf(f, ",\"args\":{\"detail\":\"");
+                write_escaped(f, e->detail);
+                fprintf(f, "\"}");
+            }
+            fputc('}', f);
+            count++;
+        }
+        ring->written = 0;
+    }
+    pthread_mutex_unlock(&rings_lock);
+
+    fprintf(f, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":%lu}}\n", dropped);
+    return count;
+}
+
+int trace_start(const char *path) {
+    if (trace_active) trace_stop();
+    pthread_once(&key_once, make_key);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "trace: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    free(trace_path);
+    trace_path = strdup(path);
+    trace_fd = fd;
+    trace_owner = getpid();
+
+    // Spans recorded after the last trace stopped are not part of this one.
+    pthread_mutex_lock(&rings_lock);
+    for (TraceRing *ring = rings; ring; ring = ring->next) ring->written = 0;
+    pthread_mutex_unlock(&rings_lock);
+    trace_active = 1;
+    return 0;
+}
+
+int trace_stop(void) {
+    if (!trace_active || getpid() != trace_owner) return 0;
+    trace_active = 0;
+
+    FILE *f = fdopen(trace_fd, "w");
+    trace_fd = -1;
+    if (!f) {
+        perror("trace");
+        return -1;
+    }
+    int count = write_trace(f);
+    if (fclose(f) != 0) {
+        fprintf(stderr, "trace: %s: %s\n", trace_path, strerror(errno));
+        return -1;
+    }
+    fprintf(stderr, "trace: %d spans written to %s\n", count, trace_path);
+    return 0;
+}
+
+void init_trace(void) {
+    const char *path = getenv("SHELL_TRACE");
+    if (path && *path) trace_start(path);
+}
+
+void cleanup_trace(void) {
+    trace_stop();
+    free(trace_path);
+    trace_path = NULL;
+    while (rings) {
+        TraceRing *next = rings->next;
+        free(rings);
+        rings = next;
+    }
+    if (trace_owner) pthread_setspecific(ring_key, NULL);
+}
+
+int trace_command(int argc, char **argv) {
+    if (argc == 1) {
+        if (trace_active) {
+            printf("trace: on, writing to %s\n", trace_path);
+        } else {
+            printf("trace: off\n");
+        }
+        return 0;
+    }
+    if (argc == 3 && strcmp(argv[1], "on") == 0) return trace_start(argv[2]) < 0;
+    if (argc == 2 && strcmp(argv[1], "off") == 0) return trace_stop() < 0;
+    printf("trace: usage: trace on FILE | trace off | trace\n");
+    return 2;
+}